@@ -0,0 +1,93 @@
+// Cost of the agent's high-rate CPU sampling: per-operation timings, heap
+// allocations in steady state, and the CPU the sampler thread actually uses
+// at several rates. Build and run with `make bench`.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "../include/cpu_sampler.h"
+#include "../include/proc_reader.h"
+#include "../include/sample_ring.h"
+
+namespace {
+std::atomic<uint64_t> g_allocs{0};
+
+double cpuSeconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+// Runs fn() iters times; prints ns/op and heap allocations per op
+template <typename F>
+double measure(const char* name, size_t iters, F&& fn) {
+    for (size_t i = 0; i < iters / 10 + 1; ++i) fn();  // warm up, size buffers
+    const uint64_t a0 = g_allocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iters; ++i) fn();
+    const auto t1 = std::chrono::steady_clock::now();
+    const uint64_t allocs = g_allocs.load() - a0;
+    const double ns =
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+    std::printf("%-34s %10.0f ns/op %8.2f allocs/op\n", name, ns,
+                static_cast<double>(allocs) / iters);
+    return ns;
+}
+}  // namespace
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+int main() {
+    std::printf("== per operation ==\n");
+    ProcStatReader stat;
+    std::vector<ProcStatReader::CpuTimes> cpus;
+    measure("ProcStatReader::readCpus", 20000, [&] { stat.readCpus(cpus); });
+
+    CpuSampler direct(std::chrono::milliseconds(1000), CpuSampler::kMaxHz);
+    const double tickNs =
+        measure("CpuSampler reading (all cores)", 20000, [&] { direct.sampleOnce(); });
+
+    SampleRing<256> ring;
+    float v = 0;
+    measure("SampleRing::push", 10000000, [&] {
+        ring.push(v);
+        v = v > 100 ? 0 : v + 1.5f;
+    });
+    measure("SampleRing::drain (50 samples)", 200000, [&] {
+        for (int i = 0; i < 50; ++i) ring.push(static_cast<float>((i * 37) % 101));
+        ring.drain();
+    });
+
+    std::printf("\n== sampler thread, %u cpu lines ==\n",
+                static_cast<unsigned>(cpus.size()));
+    std::printf("%6s %14s %14s\n", "Hz", "projected %", "measured %");
+    for (unsigned hz : {4u, 10u, 20u, 50u}) {
+        const double projected = tickNs * hz / 1e9 * 100.0;
+        CpuSampler sampler(std::chrono::milliseconds(1000), hz);
+        const double c0 = cpuSeconds();
+        const auto w0 = std::chrono::steady_clock::now();
+        sampler.start();
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+        sampler.stop();
+        const double wall = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - w0)
+                                .count();
+        const double measured = (cpuSeconds() - c0) / wall * 100.0;
+        const SampleSummary s = sampler.drainSummary();
+        std::printf("%6u %13.3f%% %13.3f%%   (%u readings, cpu max %.1f%%)\n", hz,
+                    projected, measured, s.count, s.max);
+    }
+    return 0;
+}
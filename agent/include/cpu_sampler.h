@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "proc_reader.h"
+#include "sample_ring.h"
+
+/**
+ * @brief Background CPU usage sampler.
+ *
+ * A thread reads /proc/stat at a fixed rate and keeps the readings of the
+ * last window in a small ring, so percent() and cores() answer immediately
+ * with the usage over roughly the last window instead of sleeping per
+ * request. The usage between consecutive readings also goes into a
+ * SampleRing that drainSummary() reduces to min/max/mean/p95, so spikes
+ * shorter than the window still show up.
+ */
+class CpuSampler {
+   public:
+    static constexpr unsigned kDefaultHz = 4;
+    static constexpr unsigned kMaxHz = 50;
+
+    /**
+     * @param window Span percent() and cores() are averaged over.
+     * @param hz Readings of /proc/stat per second, clamped to [1, kMaxHz].
+     */
+    explicit CpuSampler(
+        std::chrono::milliseconds window = std::chrono::milliseconds(1000),
+        unsigned hz = kDefaultHz);
+    ~CpuSampler();
+
+    CpuSampler(const CpuSampler&) = delete;
+    CpuSampler& operator=(const CpuSampler&) = delete;
+
+    void start();
+    void stop();
+
+    /**
+     * @brief CPU usage (0-100) over the last window; 0 until two samples
+     * have been taken.
+     */
+    float percent() const noexcept {
+        return percent_.load(std::memory_order_relaxed);
+    }
+
+    struct CoreUsage {
+        int core;
+        float percent;
+    };
+
+    /**
+     * @brief Per-core usage (0-100) over the last window, in core order;
+     * empty until two samples have been taken.
+     */
+    void cores(std::vector<CoreUsage>& out) const;
+
+    /**
+     * @brief Summary of the per-reading usage since the previous call
+     * (count is 0 if there was none). Never allocates.
+     */
+    SampleSummary drainSummary();
+
+    std::chrono::milliseconds window() const noexcept { return window_; }
+    std::chrono::microseconds tick() const noexcept { return tick_; }
+
+    /// Takes one reading now, as the sampling thread does (benchmarks).
+    void sampleOnce();
+
+   private:
+    // Room for 5 s of readings at kMaxHz between two drains
+    using SpikeRing = SampleRing<256>;
+
+    using Sample = std::vector<ProcStatReader::CpuTimes>;  // aggregate first
+
+    void run();
+    void sample();
+
+    ProcStatReader stat_;
+    std::chrono::milliseconds window_;
+    std::chrono::microseconds tick_;
+    // one window's worth of ticks + 1 readings: oldest and newest are one
+    // window apart
+    std::vector<Sample> ring_;
+    size_t next_ = 0;
+    size_t filled_ = 0;
+    std::atomic<float> percent_{0.0f};
+    std::vector<CoreUsage> cores_;  // guarded by mx_
+    SpikeRing spikes_;              // guarded by mx_
+
+    mutable std::mutex mx_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread thr_;
+};
@@ -0,0 +1,183 @@
+#pragma once
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../core/include/job_codec.h"
+
+/**
+ * @brief Table of the agent's exec jobs, run and multiplexed on one thread.
+ *
+ * Each command is started with posix_spawn as "/bin/sh -c <cmd>" (the command
+ * string is passed as a single argument, so it needs no quoting) in its own
+ * process group, with stdin on /dev/null and stdout and stderr on separate
+ * non-blocking pipes. One thread polls the pipes of every running command and
+ * hands each chunk read to the command's Sink tagged with its stream, then
+ * reports how the command ended once both pipes are closed and it has been
+ * reaped, so any number of commands share that thread.
+ *
+ * At most maxRunning commands run at once; later ones wait in a bounded FIFO
+ * queue and are refused once it is full. A job that is killed or outlives
+ * its timeout gets SIGTERM on its whole process group, then SIGKILL if it is
+ * still there after the grace period.
+ *
+ * Output can be coalesced: reads of one stream accumulate until the batch
+ * reaches Options::flushBytes or its oldest byte is Options::flushDelay old,
+ * which turns a command printing line by line into a few large chunks for a
+ * bounded delay. A stream switch or EOF flushes at once.
+ *
+ * A command's pipes are not read while its sink refuses a chunk or, for a
+ * flow-controlled command, while it has no credit left: the command then
+ * blocks on a full pipe instead of the agent buffering its output.
+ */
+class ExecEngine {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    enum class Stream : uint8_t { Out, Err };
+
+    struct Exit {
+        enum class Reason : uint8_t {
+            Exited,    ///< Ran to completion (or was killed by someone else).
+            Killed,    ///< Ended by kill().
+            TimedOut,  ///< Ended because it outlived its timeout.
+        };
+        int code = 0;    ///< Exit status; 128 + signal if killed, 127 if not started.
+        int signal = 0;  ///< Terminating signal, 0 if the command exited.
+        Reason reason = Reason::Exited;
+    };
+
+    /**
+     * @brief Where a command's output and exit go; called on the engine
+     * thread. A callback returning false could not take the event now (e.g.
+     * the connection's queue is full); it is offered again a little later.
+     */
+    struct Sink {
+        std::function<bool(Stream, std::string_view)> output;
+        std::function<bool(const Exit&)> done;
+    };
+
+    struct Options {
+        /// Output bytes the command may produce before it needs grant();
+        /// 0 disables flow control.
+        size_t window = 0;
+        /// Running time after which the job is killed; 0 = none.
+        std::chrono::milliseconds timeout{0};
+        /// Batch size that is sent at once (reads may overshoot it by one).
+        size_t flushBytes = 0;
+        /// Longest a byte waits in the batch; 0 sends every read as is.
+        std::chrono::milliseconds flushDelay{0};
+    };
+
+    enum class Submit : uint8_t { Started, Queued, Duplicate, Full };
+
+    /**
+     * @param maxRunning Commands running at once (at least 1).
+     * @param maxQueued Commands waiting for a slot; further ones are refused.
+     * @param killGrace Time between SIGTERM and SIGKILL.
+     */
+    explicit ExecEngine(size_t maxRunning = 16, size_t maxQueued = 256,
+                        std::chrono::milliseconds killGrace = std::chrono::seconds(2));
+    /// Kills (SIGKILL) and reaps whatever is still running.
+    ~ExecEngine();
+
+    ExecEngine(const ExecEngine&) = delete;
+    ExecEngine& operator=(const ExecEngine&) = delete;
+
+    /**
+     * @brief Starts @p cmd as job @p id, or queues it if maxRunning jobs run.
+     *
+     * A job that fails to spawn is reported through its sink with code 127.
+     * @return Duplicate if @p id is already in the table, Full if the queue
+     *         is; the sink is then never called.
+     */
+    Submit submit(int id, std::string cmd, Sink sink, Options opt);
+
+    /**
+     * @brief Adds @p bytes of output credit to job @p id; ignored once it
+     * finished.
+     */
+    void grant(int id, size_t bytes);
+
+    /**
+     * @brief Kills job @p id: a queued job is dropped and reported as killed
+     * at once, a running one gets SIGTERM then SIGKILL.
+     * @return false if there is no such job.
+     */
+    bool kill(int id);
+
+    /// Running jobs first, then queued ones in queue order.
+    void list(std::vector<JobInfo>& out) const;
+
+    /**
+     * @brief Kills every job and drops their sinks without calling them
+     * again, e.g. before the connection they write to goes away.
+     */
+    void abandonAll();
+
+    /// Jobs in the table, queued ones included.
+    size_t size() const;
+
+   private:
+    struct Job {
+        std::string cmd;
+        Sink sink;
+        Options opt;
+        clock::time_point since{};  // started, or queued
+        pid_t pid = -1;
+        int fds[2] = {-1, -1};  // read ends of stdout, stderr; -1 once at EOF
+        int64_t credit = 0;     // may go negative by one chunk
+        uint64_t bytes_out = 0;
+        std::string out;        // batch being coalesced, or refused by the sink
+        Stream outStream = Stream::Out;
+        clock::time_point outDue = clock::time_point::max();  // flushDelay
+        bool refused = false;   // the sink refused out; offered again
+        clock::time_point deadline = clock::time_point::max();  // timeout
+        clock::time_point killAt = clock::time_point::max();    // SIGKILL due
+        Exit::Reason endReason = Exit::Reason::Exited;
+        bool reaped = false;
+        Exit exit;
+        bool abandoned = false;
+    };
+    struct Queued {
+        int id;
+        Job job;
+    };
+
+    void run();
+    void wake();
+    // Spawns @p j; on failure it is left finished with code 127
+    void start(Job& j);
+    // SIGTERM to the job's group now, SIGKILL after the grace period
+    void terminate(Job& j, Exit::Reason why, clock::time_point now);
+    // Acts on due timeouts, SIGKILLs and batches; returns the next deadline
+    clock::time_point checkTimers(Job& j, clock::time_point now);
+    // Reads what @p fd has into the batch; called with mx_ held
+    void readPipe(Job& j, int slot, clock::time_point now);
+    // Hands the batch to the sink; true once nothing is left to send
+    bool flush(Job& j);
+    static bool paused(const Job& j);
+    static bool finished(const Job& j);
+
+    const size_t maxRunning_;
+    const size_t maxQueued_;
+    const std::chrono::milliseconds killGrace_;
+
+    mutable std::mutex mx_;  // held while calling sinks, see abandonAll()
+    std::unordered_map<int, Job> jobs_;  // started (or finished, reporting)
+    std::deque<Queued> queue_;
+    int wakeFd_ = -1;  // eventfd interrupting poll()
+    bool stopping_ = false;
+    std::vector<char> buf_;
+    std::thread thr_;
+};
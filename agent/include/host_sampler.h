@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../core/include/metric_set.h"
+#include "cpu_sampler.h"
+#include "mount_table.h"
+#include "proc_reader.h"
+
+/**
+ * @brief Background collector of the agent's full metric set.
+ *
+ * Every interval a thread reads memory, mounted filesystems, load average,
+ * /proc/net/dev and /proc/diskstats, turns the I/O counters into per-second
+ * rates against the previous reading, adds CPU usage from the CpuSampler
+ * (with the min/max/p95 of its high-rate readings over the interval), and
+ * publishes the result as an immutable MetricSet. STATUS replies and
+ * the telemetry pusher share that snapshot, so rates do not depend on how
+ * often either of them asks.
+ */
+class HostSampler {
+   public:
+    explicit HostSampler(
+        CpuSampler& cpu,
+        std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    ~HostSampler();
+
+    HostSampler(const HostSampler&) = delete;
+    HostSampler& operator=(const HostSampler&) = delete;
+
+    /// Takes the first sample (without rates) before returning.
+    void start();
+    void stop();
+
+    /// Latest sample; never null once start() has returned.
+    std::shared_ptr<const MetricSet> latest() const;
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+    void sample();
+
+    CpuSampler& cpu_;
+    std::chrono::milliseconds interval_;
+
+    // Used by the sampling thread only
+    MeminfoReader meminfo_;
+    LoadavgReader loadavg_;
+    NetDevReader netdev_;
+    DiskstatsReader diskstats_;
+    MountTable mounts_;
+    std::vector<CpuSampler::CoreUsage> cores_;
+    std::vector<NetDevReader::Counters> net_, prevNet_;
+    std::vector<DiskstatsReader::Counters> disk_, prevDisk_;
+    Clock::time_point prevAt_{};
+
+    mutable std::mutex latestMx_;
+    std::shared_ptr<const MetricSet> latest_;
+
+    std::mutex mx_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread thr_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief The agent's real filesystems and their usage.
+ *
+ * Parses /proc/self/mountinfo, leaving out pseudo filesystems (proc, sysfs,
+ * tmpfs, cgroup, ...) and repeated mounts of the same device. "/" is exempt
+ * from both and always listed, since the root disk figures come from it
+ * (tmpfs or squashfs roots, btrfs subvolumes whose top level is mounted
+ * elsewhere). The parsed
+ * table is kept and re-parsed only when poll() on the open mountinfo file
+ * reports that the mount table changed. statvfs() is rate-limited per mount:
+ * local filesystems are re-read every kLocalInterval, remote ones every
+ * kRemoteInterval, and a mount whose statvfs() was slow backs off to
+ * kSlowInterval, so the cost of a sample does not grow with slow mounts.
+ * statvfs() of a remote mount runs on a short-lived thread of its own and
+ * its result is picked up by a later refresh(); the mount keeps its last
+ * figures meanwhile. An unresponsive server (hard-mounted NFS) thus strands
+ * at most one thread per mount instead of the sampling thread.
+ * Not thread-safe: owned by the sampling thread.
+ */
+class MountTable {
+   public:
+    /// statvfs() of a remote mount in flight on its own thread.
+    struct Probe {
+        std::mutex mx;
+        bool done = false;
+        uint64_t used_kb = 0;
+        uint64_t total_kb = 0;
+        std::chrono::steady_clock::time_point started{};
+        std::chrono::steady_clock::duration took{};
+    };
+
+    struct Mount {
+        std::string point;   ///< Mount point, unescaped.
+        std::string fstype;
+        bool remote = false;
+        uint64_t used_kb = 0;
+        uint64_t total_kb = 0;
+        bool measured = false;  ///< statvfs() has succeeded at least once.
+        std::chrono::steady_clock::time_point nextStat{};
+        std::shared_ptr<Probe> probe;  ///< Remote statvfs() not collected yet.
+    };
+
+    static constexpr std::chrono::seconds kLocalInterval{5};
+    static constexpr std::chrono::seconds kRemoteInterval{30};
+    static constexpr std::chrono::seconds kSlowInterval{120};
+    static constexpr std::chrono::milliseconds kSlowCall{100};
+
+    MountTable();
+    ~MountTable();
+
+    MountTable(const MountTable&) = delete;
+    MountTable& operator=(const MountTable&) = delete;
+
+    /**
+     * @brief Re-parses the table if it changed, then runs the statvfs()
+     * calls that are due.
+     * @return The mounts, in mountinfo order.
+     */
+    const std::vector<Mount>& refresh();
+
+    /// Times the table has been parsed (diagnostics).
+    uint64_t parses() const noexcept { return parses_; }
+
+   private:
+    bool changed();
+    void parse();
+    void stat(Mount& m, std::chrono::steady_clock::time_point now);
+    // Starts @p m's statvfs() on a thread; false if none could be created
+    static bool startProbe(Mount& m, std::chrono::steady_clock::time_point now);
+    // Takes the result of @p m's probe if it has returned
+    static void collectProbe(Mount& m);
+
+    int fd_ = -1;
+    bool parsed_ = false;
+    uint64_t parses_ = 0;
+    std::vector<char> buf_;
+    std::vector<Mount> mounts_;
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file proc_reader.h
+ * @brief Allocation-free readers for /proc files.
+ *
+ * Each reader keeps its file descriptor open and re-reads the file with
+ * pread() into a fixed buffer it owns, then parses it with the scanners
+ * below. A sample performs two syscalls and no heap allocation. Readers are
+ * not thread-safe: each one belongs to a single sampling thread (or to a
+ * serialized handler). Readers that return a table fill a caller-owned
+ * vector, which keeps its capacity from one sample to the next.
+ */
+
+namespace procscan {
+
+inline bool isDigit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+/**
+ * @brief Skips blanks, then parses an unsigned decimal at @p p.
+ * @return false (leaving @p p past the blanks) if no digit follows.
+ */
+inline bool nextU64(const char*& p, const char* end, uint64_t& v) noexcept {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p == end || !isDigit(*p)) return false;
+    uint64_t x = 0;
+    while (p < end && isDigit(*p)) x = x * 10 + static_cast<uint64_t>(*p++ - '0');
+    v = x;
+    return true;
+}
+
+/**
+ * @brief Skips blanks, then parses a decimal such as "0.52" as hundredths
+ * (52); further fraction digits are dropped.
+ */
+inline bool nextCenti(const char*& p, const char* end, uint64_t& v) noexcept {
+    uint64_t whole = 0;
+    if (!nextU64(p, end, whole)) return false;
+    uint64_t frac = 0;
+    if (p < end && *p == '.') {
+        ++p;
+        for (int i = 0; i < 2; ++i) {
+            frac *= 10;
+            if (p < end && isDigit(*p)) frac += static_cast<uint64_t>(*p++ - '0');
+        }
+        while (p < end && isDigit(*p)) ++p;
+    }
+    v = whole * 100 + frac;
+    return true;
+}
+
+/// Skips blanks, then returns the run of non-blank characters at @p p.
+inline std::string_view nextToken(const char*& p, const char* end) noexcept {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    const char* b = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\n') ++p;
+    return {b, static_cast<size_t>(p - b)};
+}
+
+/// Moves @p p past the next '\n' (or to @p end).
+inline void nextLine(const char*& p, const char* end) noexcept {
+    while (p < end && *p != '\n') ++p;
+    if (p < end) ++p;
+}
+
+/// True if the line at @p p starts with @p key; @p p is then moved past it.
+inline bool consume(const char*& p, const char* end,
+                    std::string_view key) noexcept {
+    if (static_cast<size_t>(end - p) < key.size() ||
+        std::string_view(p, key.size()) != key)
+        return false;
+    p += key.size();
+    return true;
+}
+
+}  // namespace procscan
+
+/**
+ * @brief Short device name (NIC or block device) stored inline.
+ */
+struct DevName {
+    char s[32] = {};
+    uint8_t len = 0;
+
+    void assign(std::string_view v) noexcept {
+        len = static_cast<uint8_t>(v.size() < sizeof(s) ? v.size() : sizeof(s) - 1);
+        std::memcpy(s, v.data(), len);
+    }
+    std::string_view view() const noexcept { return {s, len}; }
+};
+
+/**
+ * @brief A /proc (or /sys) file kept open and re-read from offset 0.
+ */
+class ProcFile {
+   public:
+    explicit ProcFile(const char* path) noexcept : path_(path) {}
+    ~ProcFile();
+
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    /**
+     * @brief Reads the file (up to @p cap bytes) into @p buf.
+     *
+     * Opens the file on first use and reopens it after a failed read. If the
+     * file filled the buffer, truncated() is set and the partial last line is
+     * left out, so a parser never sees a cut-off field.
+     * @return The bytes read; empty on error.
+     */
+    std::string_view read(char* buf, size_t cap) noexcept;
+
+    /**
+     * @brief Reads the whole file into @p buf, doubling it (up to kMaxSize)
+     * until the file fits.
+     *
+     * The buffer keeps its size, so once it has grown to fit, later reads
+     * do not allocate.
+     */
+    std::string_view read(std::vector<char>& buf) noexcept;
+
+    /// Whether the last read stopped at the end of the buffer.
+    bool truncated() const noexcept { return truncated_; }
+
+    static constexpr size_t kMaxSize = 4 << 20;
+
+   private:
+    const char* path_;
+    int fd_ = -1;
+    bool truncated_ = false;
+};
+
+/**
+ * @brief CPU times from the "cpu" lines at the top of /proc/stat.
+ */
+class ProcStatReader {
+   public:
+    struct CpuTimes {
+        int core;        ///< -1 for the aggregate line.
+        uint64_t idle;   ///< idle + iowait jiffies.
+        uint64_t total;  ///< All jiffies.
+    };
+
+    ProcStatReader() noexcept : file_("/proc/stat") {}
+
+    /**
+     * @brief The aggregate line first, then one entry per online core
+     * (offline cores have no line, so entries carry their core number).
+     */
+    bool readCpus(std::vector<CpuTimes>& out) noexcept;
+
+   private:
+    ProcFile file_;
+    char buf_[32768];  // the cpu lines come first: room for a few hundred cores
+};
+
+/**
+ * @brief The three load averages from /proc/loadavg.
+ */
+class LoadavgReader {
+   public:
+    LoadavgReader() noexcept : file_("/proc/loadavg") {}
+
+    /// 1, 5 and 15 minute load averages x100.
+    bool read(uint64_t (&centi)[3]) noexcept;
+
+   private:
+    ProcFile file_;
+    char buf_[128];
+};
+
+/**
+ * @brief Per-interface traffic counters from /proc/net/dev (loopback left out).
+ */
+class NetDevReader {
+   public:
+    struct Counters {
+        DevName name;
+        uint64_t rxBytes, rxPackets, txBytes, txPackets;
+    };
+
+    NetDevReader() : file_("/proc/net/dev"), buf_(16384) {}
+
+    bool read(std::vector<Counters>& out) noexcept;
+
+   private:
+    ProcFile file_;
+    std::vector<char> buf_;  // grows to fit hosts with many interfaces
+};
+
+/**
+ * @brief Per-device I/O counters from /proc/diskstats.
+ *
+ * Only whole devices are kept: partitions (listed after their disk),
+ * loop, ram and zram devices are skipped.
+ */
+class DiskstatsReader {
+   public:
+    struct Counters {
+        DevName name;
+        uint64_t reads, readSectors, writes, writeSectors;  // 512-byte sectors
+    };
+
+    DiskstatsReader() : file_("/proc/diskstats"), buf_(32768) {}
+
+    bool read(std::vector<Counters>& out) noexcept;
+
+   private:
+    ProcFile file_;
+    std::vector<char> buf_;  // grows to fit hosts with many devices
+};
+
+/**
+ * @brief MemTotal / MemAvailable from /proc/meminfo.
+ */
+class MeminfoReader {
+   public:
+    MeminfoReader() noexcept : file_("/proc/meminfo") {}
+
+    /**
+     * @brief Used (MemTotal - MemAvailable) and total memory in KiB.
+     */
+    bool read(uint64_t& used_kb, uint64_t& total_kb) noexcept;
+
+   private:
+    ProcFile file_;
+    char buf_[4096];
+};
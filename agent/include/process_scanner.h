@@ -0,0 +1,69 @@
+#pragma once
+#include <dirent.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../../core/include/top_codec.h"
+
+/**
+ * @brief Finds the busiest processes from /proc/[pid]/stat.
+ *
+ * Each scan reads only the stat file of every pid, through openat() on a
+ * /proc directory handle kept open, and measures CPU against the ticks that
+ * pid had at the previous scan, kept in a per-pid cache. Entries for pids
+ * that are gone are dropped, and a reused pid is detected by its start
+ * time. Only the top N are ever sorted (nth_element, then a sort of N).
+ * Thread-safe: scans are serialized.
+ */
+class ProcessScanner {
+   public:
+    enum class SortBy { Cpu, Rss };
+
+    ProcessScanner();
+    ~ProcessScanner();
+
+    ProcessScanner(const ProcessScanner&) = delete;
+    ProcessScanner& operator=(const ProcessScanner&) = delete;
+
+    /**
+     * @brief Scans /proc and returns the @p n top processes by @p by,
+     * highest first.
+     *
+     * CPU usage covers the time since the previous scan; the very first
+     * call scans twice, kPrimeDelay apart, so its numbers mean something.
+     */
+    void top(size_t n, SortBy by, std::vector<ProcInfo>& out);
+
+    static constexpr std::chrono::milliseconds kPrimeDelay{250};
+
+   private:
+    struct Entry {
+        uint64_t starttime = 0;  // ticks after boot; tells reused pids apart
+        uint64_t ticks = 0;      // utime + stime at the last scan
+        uint64_t rss_kb = 0;
+        uint32_t cpu_centi = 0;
+        uint32_t seen = 0;       // generation of the last scan that saw it
+        char comm[16] = {};
+    };
+
+    struct Candidate {
+        uint64_t key;
+        uint32_t pid;
+    };
+
+    void scan(SortBy by);  // refreshes cache_ and candidates_
+
+    std::mutex mx_;
+    DIR* dir_ = nullptr;
+    std::unordered_map<uint32_t, Entry> cache_;
+    std::vector<Candidate> candidates_;
+    uint32_t generation_ = 0;
+    std::chrono::steady_clock::time_point lastScan_{};
+    long ticksPerSec_;
+    long pageKb_;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief min/max/mean/p95 of the samples taken over one reporting interval.
+ */
+struct SampleSummary {
+    uint32_t count = 0;  ///< Samples summarized; 0 means the other fields are unset.
+    float min = 0;
+    float max = 0;
+    float mean = 0;
+    float p95 = 0;
+};
+
+/**
+ * @brief Fixed-capacity ring of samples, summarized and emptied by drain().
+ *
+ * Both push() and drain() work on inline arrays and never allocate. If more
+ * than N samples arrive between two drains, the oldest are overwritten.
+ * Not thread-safe: the owner serializes push() and drain().
+ */
+template <size_t N>
+class SampleRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+   public:
+    static constexpr size_t kCapacity = N;
+
+    void push(float v) noexcept {
+        buf_[head_ & (N - 1)] = v;
+        ++head_;
+    }
+
+    /// Samples waiting for the next drain().
+    size_t pending() const noexcept {
+        return static_cast<size_t>(std::min<uint64_t>(head_ - tail_, N));
+    }
+
+    /**
+     * @brief Summarizes the samples pushed since the last drain and forgets
+     * them.
+     */
+    SampleSummary drain() noexcept {
+        SampleSummary s;
+        const size_t n = pending();
+        tail_ = head_;
+        if (n == 0) return s;
+
+        // copy out in push order, then select the p95 in place
+        const uint64_t first = head_ - n;
+        double sum = 0;
+        s.min = s.max = buf_[first & (N - 1)];
+        for (size_t i = 0; i < n; ++i) {
+            const float v = buf_[(first + i) & (N - 1)];
+            scratch_[i] = v;
+            sum += v;
+            s.min = std::min(s.min, v);
+            s.max = std::max(s.max, v);
+        }
+        // nearest-rank percentile: the ceil(0.95 n)-th smallest value
+        const size_t rank = (n * 95 + 99) / 100 - 1;
+        std::nth_element(scratch_.begin(), scratch_.begin() + rank,
+                         scratch_.begin() + n);
+        s.count = static_cast<uint32_t>(n);
+        s.mean = static_cast<float>(sum / n);
+        s.p95 = scratch_[rank];
+        return s;
+    }
+
+   private:
+    std::array<float, N> buf_{};
+    std::array<float, N> scratch_{};
+    uint64_t head_ = 0;  // samples ever pushed
+    uint64_t tail_ = 0;  // value of head_ at the last drain
+};
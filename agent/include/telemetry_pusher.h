@@ -0,0 +1,61 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "../../core/include/status_codec.h"
+
+class Connection;
+
+/**
+ * @brief Pushes TELEMETRY frames to a subscribed controller.
+ *
+ * After SUBSCRIBE the agent samples on its own schedule and sends only the
+ * fields that moved past their thresholds, with a full keyframe every few
+ * frames, so the controller no longer has to poll with STATUS. One pusher
+ * serves whichever connection is current; unsubscribe() must be called
+ * before that connection is destroyed.
+ */
+class TelemetryPusher {
+   public:
+    /// Returns the current metrics; only ever called from the pusher thread.
+    using Source = std::function<std::shared_ptr<const MetricSet>()>;
+
+    explicit TelemetryPusher(Source source) : source_(std::move(source)) {}
+    ~TelemetryPusher();
+
+    TelemetryPusher(const TelemetryPusher&) = delete;
+    TelemetryPusher& operator=(const TelemetryPusher&) = delete;
+
+    /**
+     * @brief Starts (or retunes) pushing to @p c every @p interval. The first
+     * frame, a keyframe, goes out immediately.
+     */
+    void subscribe(Connection& c, std::chrono::milliseconds interval,
+                   uint32_t keyframeEvery);
+
+    /**
+     * @brief Stops pushing; no frame is sent to the old connection once this
+     * returns.
+     */
+    void unsubscribe();
+
+   private:
+    void run();
+
+    Source source_;
+
+    std::mutex mx_;  // held while sending, see unsubscribe()
+    std::condition_variable cv_;
+    Connection* conn_ = nullptr;
+    std::chrono::milliseconds interval_{0};
+    std::optional<TelemetryEncoder> encoder_;
+    uint64_t generation_ = 0;  // bumped by every (un)subscribe
+    bool stopping_ = false;
+    std::thread thr_;
+};
@@ -1,16 +1,24 @@
-
-
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <chrono>
 #include <thread>
 
+#include "../../core/include/status_codec.h"
 #include "../../core/include/utils.h"
 #include "../core/include/connection.h"
+#include "../core/include/dispatch_table.h"
+#include "../core/include/protocol.h"
 #include "../core/include/tcp_client.h"
-#include "../include/system_helpers.h"
+#include "../include/cpu_sampler.h"
+#include "../include/exec_engine.h"
+#include "../include/host_sampler.h"
+#include "../include/process_scanner.h"
+#include "../include/telemetry_pusher.h"
 
-bool connectWithRetry(const char* host, uint16_t port, const std::string& token, std::unique_ptr<Connection>& conn) {
+bool connectWithRetry(const char* host, uint16_t port, const std::string& token, std::unique_ptr<Connection>& conn,
+                      const std::shared_ptr<const DispatchTable>& handlers) {
     const int MAX_RETRY_DELAY = 30; // max 30 seconds between retries
     int retry_delay = 1; // start with 1 second
 // Attempts to connect to the server with exponential backoff on failure
@@ -23,8 +31,11 @@ bool connectWithRetry(const char* host, uint16_t port, const std::string& token,
             std::cout << "[agent] connected, fd=" << cli.fd() << "\n";
             
             conn = std::make_unique<Connection>(cli.release());
+            conn->setDispatchTable(handlers); // handlers must exist before the OK to AUTH arrives
             conn->start();
-            conn->send("AUTH", token);
+            // Offer protocol v2 with compression; the controller confirms
+            // what it supports in its OK reply
+            conn->send(specula::CMD_AUTH, token + " proto=2 comp=lz");
             
             return true;
         }
@@ -45,99 +56,273 @@ int main() {
     std::unique_ptr<Connection> conn;
 
     std::atomic<bool> want_close{false};
+    // Runs EXEC commands; one thread drives every command's pipes. At most
+    // EXEC_MAX_RUNNING run at once, EXEC_MAX_QUEUED more wait for a slot
+    const size_t EXEC_MAX_RUNNING = 16;
+    const size_t EXEC_MAX_QUEUED = 256;
+    ExecEngine exec(EXEC_MAX_RUNNING, EXEC_MAX_QUEUED);
+
+    // CPU usage is sampled in the background so STATUS answers immediately
+    const auto CPU_WINDOW = std::chrono::milliseconds(1000);
+    // Readings per second; STATUS/TELEMETRY carry min/max/p95 of each
+    // interval's readings, so spikes shorter than the window still show
+    const unsigned CPU_SAMPLE_HZ = 20;
+    CpuSampler cpu(CPU_WINDOW, CPU_SAMPLE_HZ);
+    cpu.start();
+    // Everything else (memory, disk, load, NIC and block I/O rates) is
+    // collected once per window too; STATUS and telemetry share the result
+    HostSampler host(cpu, CPU_WINDOW);
+    host.start();
+
+    TelemetryPusher telemetry([&host] { return host.latest(); });
+
+    // Per-pid tick cache for TOP; it keeps the previous scan's counters
+    ProcessScanner processes;
     
-    auto setupHandlers = [&](Connection& c) {
-        c.setDefaultHandler([](Connection&, const std::string& payload) {
-            std::cerr << "[controller->agent][UNKNOWN] " << payload;
+    // Message handlers, built once and shared by every (re)connection
+    auto handlers = std::make_shared<DispatchTable>();
+    {
+        DispatchTable& t = *handlers;
+        t.setDefault([](Connection&, const Frame& f) {
+            std::cerr << "[controller->agent][UNKNOWN] " << f.cmd << " " << f.payload;
     // Lambda to set up message handlers for the connection
         });
 
-        c.on("PING",
-                [](Connection& c, const std::string&) { c.send("PONG", ""); });
+        // Handles the reply to AUTH: switches to protocol v2 if the controller agreed
+        t.on(specula::RESP_OK, [](Connection& c, const Frame& f) {
+            auto kv = parse_kv(f.payload);
+            auto proto = kv.find(std::string(specula::PROTO_KEY));
+            if (proto != kv.end() && proto->second == "2") {
+                c.setProtocol(specula::PROTO_BINARY);
+                auto comp = kv.find(std::string(specula::COMP_KEY));
+                const bool lz = comp != kv.end() && comp->second == specula::COMP_LZ;
+                c.setCompression(lz);
+                std::cout << "[agent] authenticated, protocol v2"
+                          << (lz ? " (compressed)" : "") << "\n";
+            }
+        });
+
+        t.on(specula::CMD_PING,
+                [](Connection& c, const Frame&) { c.send(specula::CMD_PONG, ""); });
 
         // Responds to PING with PONG
-        c.on("STATUS", [](Connection& c, const std::string&) {
-            float cpu = get_cpu_percent();
-            uint64_t mem_used_kb = 0, mem_total_kb = 0;
-        // Handles STATUS requests: sends CPU, memory, and disk usage
-            get_mem(mem_used_kb, mem_total_kb);
-            uint64_t dsk_used_kb = 0, dsk_total_kb = 0;
-            get_disk(dsk_used_kb, dsk_total_kb, "/");
-
-            std::ostringstream os;
-            os << "cpu=" << std::fixed << std::setprecision(1) << cpu << "% "
-               << "mem=" << mem_used_kb << "/" << mem_total_kb << " "
-               << "disk=" << dsk_used_kb << "/" << dsk_total_kb << "\n";
-            c.send("STATUS", os.str());
+        t.on(specula::CMD_STATUS, [&host](Connection& c, const Frame&) {
+            auto m = host.latest();
+        // Handles STATUS requests: sends the latest metric set (v1: CPU, memory and disk only)
+            if (c.protocol() >= specula::PROTO_BINARY)
+                c.send(specula::CMD_STATUS, encodeStatusBinary(*m), 0, specula::FLAG_BINARY);
+            else
+                c.send(specula::CMD_STATUS, encodeStatusText(*m));
         });
 
-        c.on("EXEC", [](Connection& c, const std::string& payload) {
+        // Subscription to pushed telemetry: "interval=<ms> keyframe=<n>";
+        // interval=0 unsubscribes. Pushed frames are binary, so v2 only.
+        t.on(specula::CMD_SUBSCRIBE, [&telemetry](Connection& c, const Frame& f) {
+            auto kv = parse_kv(f.payload);
+            long interval = 0;
+            unsigned long keyframe = specula::TELEMETRY_KEYFRAME_EVERY;
+            try {
+                auto i = kv.find(std::string(specula::SUB_INTERVAL_KEY));
+                if (i != kv.end()) interval = std::stol(i->second);
+                auto k = kv.find(std::string(specula::SUB_KEYFRAME_KEY));
+                if (k != kv.end()) keyframe = std::stoul(k->second);
+            } catch (...) {
+            }
+            if (interval <= 0 || c.protocol() < specula::PROTO_BINARY) {
+                telemetry.unsubscribe();
+                return;
+            }
+            const long MIN_INTERVAL_MS = 100;
+            const long every = std::max(interval, MIN_INTERVAL_MS);
+            telemetry.subscribe(c, std::chrono::milliseconds(every),
+                                static_cast<uint32_t>(keyframe));
+            std::cout << "[agent] pushing telemetry every " << every << " ms\n";
+        });
+
+        // Top processes: "n=<count> by=cpu|mem". Concurrent, since the first
+        // scan waits to get a CPU baseline
+        t.on(specula::CMD_TOP, [&processes](Connection& c, const Frame& f) {
+            auto kv = parse_kv(f.payload);
+            unsigned long n = specula::TOP_DEFAULT_COUNT;
+            try {
+                auto it = kv.find(std::string(specula::TOP_COUNT_KEY));
+                if (it != kv.end()) n = std::stoul(it->second);
+            } catch (...) {
+            }
+            n = std::min<unsigned long>(n, specula::TOP_MAX_COUNT);
+            auto by = kv.find(std::string(specula::TOP_BY_KEY));
+            const auto sortBy = (by != kv.end() && by->second == "mem")
+                                    ? ProcessScanner::SortBy::Rss
+                                    : ProcessScanner::SortBy::Cpu;
+
+            std::vector<ProcInfo> procs;
+            processes.top(n, sortBy, procs);
+            if (c.protocol() >= specula::PROTO_BINARY)
+                c.send(specula::CMD_TOP, encodeTopBinary(procs), f.requestId,
+                       specula::FLAG_BINARY);
+            else
+                c.send(specula::CMD_TOP, encodeTopText(procs), f.requestId);
+        }, DispatchTable::Mode::Concurrent);
+
+        t.on(specula::CMD_EXEC, [&exec](Connection& c, const Frame& f) {
+            std::string_view payload = f.payload;
             std::cout << "[agent] EXEC received\n";
             auto nl = payload.find('\n');
-        // Handles EXEC requests: executes system commands
-            std::string opts =
-                (nl == std::string::npos) ? payload : payload.substr(0, nl);
-            std::string cmd =
-                (nl == std::string::npos) ? "" : payload.substr(nl + 1);
+        // Handles EXEC requests: starts the command on the exec engine, which
+        // streams its output and reports its exit from its own thread
+            std::string_view opts =
+                (nl == std::string_view::npos) ? payload : payload.substr(0, nl);
+            std::string cmd(
+                (nl == std::string_view::npos) ? std::string_view{} : payload.substr(nl + 1));
 
             auto kv = parse_kv(opts);
             int id = 0;
             bool monitor = false;
+            ExecEngine::Options opt; // window 0: controller does not do flow control
+            opt.flushBytes = specula::EXEC_FLUSH_BYTES;
+            opt.flushDelay = std::chrono::milliseconds(specula::EXEC_FLUSH_DELAY_MS);
             try {
                 if (kv.count("id")) id = std::stoi(kv["id"]);
                 if (kv.count("monitor"))
                     monitor = (kv["monitor"] == "1" || kv["monitor"] == "true");
+                auto w = kv.find(std::string(specula::EXEC_WINDOW_KEY));
+                if (w != kv.end()) opt.window = std::stoul(w->second);
+                auto t = kv.find(std::string(specula::EXEC_TIMEOUT_KEY));
+                if (t != kv.end()) opt.timeout = std::chrono::milliseconds(std::stoul(t->second));
+                auto fb = kv.find(std::string(specula::EXEC_FLUSH_KEY));
+                if (fb != kv.end())
+                    opt.flushBytes = std::min<size_t>(std::stoul(fb->second),
+                                                      specula::EXEC_FLUSH_MAX_BYTES);
+                auto fd = kv.find(std::string(specula::EXEC_DELAY_KEY));
+                if (fd != kv.end())
+                    opt.flushDelay = std::chrono::milliseconds(std::min<unsigned long>(
+                        std::stoul(fd->second), specula::EXEC_FLUSH_MAX_DELAY_MS));
             } catch (...) {
             }
 
             cmd = trim(cmd);
 
+            auto sendDone = [&c, id](const ExecEngine::Exit& e) {
+                std::ostringstream os;
+                os << "id=" << id << " code=" << e.code;
+                if (e.signal) os << " " << specula::EXEC_SIGNAL_KEY << "=" << e.signal;
+                if (e.reason == ExecEngine::Exit::Reason::Killed)
+                    os << " " << specula::EXEC_REASON_KEY << "=" << specula::EXEC_REASON_KILLED;
+                else if (e.reason == ExecEngine::Exit::Reason::TimedOut)
+                    os << " " << specula::EXEC_REASON_KEY << "=" << specula::EXEC_REASON_TIMEOUT;
+                os << "\n";
+                // false above the high-water mark: the engine retries
+                return c.send(specula::CMD_EXEC_DONE, os.str(), id) || !c.isRunning();
+            };
+
             if (cmd.empty()) {
-                c.send("EXEC_DONE",
-                       "id=" + std::to_string(id) + " code=127\n");
+                sendDone({127, 0});
                 return;
             }
 
+            ExecEngine::Sink sink;
             if (!monitor) {
-                int code = exec_command_stream(
-                    cmd, [&](const std::string&) { });
-            // If not monitoring, just execute and return exit code
-                std::ostringstream os;
-                os << "id=" << id << " code=" << code << "\n";
-                c.send("EXEC_DONE", os.str());
+                // If not monitoring, output is discarded; only the exit code goes back
+                sink.output = [](ExecEngine::Stream, std::string_view) { return true; };
+                opt.window = 0;
+                opt.flushDelay = std::chrono::milliseconds(0);
             } else {
-                int code = exec_command_stream(cmd, [&](const std::string& chunk) {
+                // v1 header, built once: "id=<id>\n" or "id=<id> stream=err\n"
+                const std::string v1Out = "id=" + std::to_string(id) + "\n";
+                const std::string v1Err = "id=" + std::to_string(id) + " " +
+                                          std::string(specula::EXEC_STREAM_KEY) + "=" +
+                                          std::string(specula::EXEC_STREAM_ERR) + "\n";
+                sink.output = [&c, id, v1Out, v1Err](ExecEngine::Stream s,
+                                                     std::string_view chunk) {
+                    // v2 carries the id and the stream in the frame header, so
+                    // the chunk goes out as is
+                    const bool err = s == ExecEngine::Stream::Err;
+                    std::string frame;
+                    if (c.protocol() >= specula::PROTO_BINARY) {
+                        frame.assign(chunk);
+                    } else {
+                        const std::string& hdr = err ? v1Err : v1Out;
+                        frame.reserve(hdr.size() + chunk.size());
+                        frame.append(hdr).append(chunk);
+                    }
+                    // outbound queue above its high-water mark: the engine
+                    // stops reading this command and offers the chunk again
+                    return c.send(specula::CMD_EXEC_OUT, std::move(frame), id,
+                                  err ? specula::FLAG_STDERR : 0) ||
+                           !c.isRunning();
+                };
+            }
+            sink.done = sendDone;
+            switch (exec.submit(id, std::move(cmd), std::move(sink), opt)) {
+                case ExecEngine::Submit::Started:
+                case ExecEngine::Submit::Queued:
+                    break;
+                case ExecEngine::Submit::Duplicate:
+                    c.send(specula::RESP_ERR, "duplicate_id id=" + std::to_string(id) + "\n", id);
+                    break;
+                case ExecEngine::Submit::Full: {
+                    // too many jobs already: refused without running
                     std::ostringstream os;
-                    os << "id=" << id << "\n"
-                // If monitoring, stream output chunks as EXEC_OUT
-                       << chunk;
-                    c.send("EXEC_OUT", os.str());
-                });
-                std::ostringstream os;
-                os << "id=" << id << " code=" << code << "\n";
-                c.send("EXEC_DONE", os.str());
+                    os << "id=" << id << " code=127 " << specula::EXEC_REASON_KEY << "="
+                       << specula::EXEC_REASON_BUSY << "\n";
+                    c.send(specula::CMD_EXEC_DONE, os.str(), id);
+                    break;
+                }
+            }
+        });
+
+        // Kills a job, or drops it from the queue; its EXEC_DONE follows
+        t.on(specula::CMD_EXEC_KILL, [&exec](Connection& c, const Frame& f) {
+            auto kv = parse_kv(f.payload);
+            int id = static_cast<int>(f.requestId);
+            try {
+                if (kv.count("id")) id = std::stoi(kv["id"]);
+            } catch (...) {
             }
+            if (!exec.kill(id))
+                c.send(specula::RESP_ERR, "unknown_id id=" + std::to_string(id) + "\n", id);
         });
 
-        c.on("BYE", [&](Connection& c, const std::string&) {
-            c.send("OK", "bye\n");
+        // Running and queued jobs, answered with the request id
+        t.on(specula::CMD_EXEC_LIST, [&exec](Connection& c, const Frame& f) {
+            std::vector<JobInfo> jobs;
+            exec.list(jobs);
+            if (c.protocol() >= specula::PROTO_BINARY)
+                c.send(specula::CMD_EXEC_LIST, encodeJobsBinary(jobs), f.requestId,
+                       specula::FLAG_BINARY);
+            else
+                c.send(specula::CMD_EXEC_LIST, encodeJobsText(jobs), f.requestId);
+        });
+
+        // Credit returned by the controller for an EXEC_OUT stream
+        t.on(specula::CMD_EXEC_CREDIT, [&exec](Connection&, const Frame& f) {
+            auto kv = parse_kv(f.payload);
+            int id = static_cast<int>(f.requestId);
+            size_t bytes = 0;
+            try {
+                if (kv.count("id")) id = std::stoi(kv["id"]);
+                if (kv.count("bytes")) bytes = std::stoul(kv["bytes"]);
+            } catch (...) {
+            }
+            if (id > 0 && bytes > 0) exec.grant(id, bytes);
+        });
+
+        t.on(specula::CMD_BYE, [&](Connection& c, const Frame&) {
+            c.send(specula::RESP_OK, "bye\n");
             want_close = true; 
         // Handles BYE requests: signals agent to close connection
         });
-    };
+    }
 
     // Main connection loop with automatic reconnection
     while (!want_close.load()) {
         // Try to connect (with retries built-in)
     // Main connection loop: reconnects if connection is lost
-        if (!connectWithRetry(HOST, PORT, TOKEN, conn)) {
+        if (!connectWithRetry(HOST, PORT, TOKEN, conn, handlers)) {
             std::cerr << "[agent] failed to establish connection\n";
             continue;
         }
         
-        // Setup message handlers
-        setupHandlers(*conn);
-        
         std::cout << "[agent] connection established, entering main loop\n";
         
         // Main message processing loop
@@ -148,6 +333,8 @@ int main() {
         // Connection lost or want_close requested
         if (conn) {
             conn->stop();
+            telemetry.unsubscribe(); // before the connection it points at goes away
+            exec.abandonAll();       // likewise for the commands' sinks
             conn.reset();
         }
         
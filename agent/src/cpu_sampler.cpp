@@ -0,0 +1,102 @@
+#include "../include/cpu_sampler.h"
+
+#include <algorithm>
+
+CpuSampler::CpuSampler(std::chrono::milliseconds window, unsigned hz)
+    : window_(window),
+      tick_(std::chrono::microseconds(1000000 / std::clamp(hz, 1u, kMaxHz))),
+      ring_(static_cast<size_t>(std::max<int64_t>(
+                1, std::chrono::microseconds(window).count() / tick_.count())) +
+            1) {}
+
+CpuSampler::~CpuSampler() { stop(); }
+
+void CpuSampler::start() {
+    std::lock_guard<std::mutex> lk(mx_);
+    if (running_) return;
+    running_ = true;
+    sample();  // first reading now, so the first window completes on time
+    thr_ = std::thread([this] { run(); });
+}
+
+void CpuSampler::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thr_.joinable()) thr_.join();
+}
+
+void CpuSampler::run() {
+    std::unique_lock<std::mutex> lk(mx_);
+    // Fixed-rate schedule; after a stall, skip ticks rather than bunch up
+    auto next = std::chrono::steady_clock::now();
+    while (running_) {
+        next += tick_;
+        const auto now = std::chrono::steady_clock::now();
+        if (next < now) next = now + tick_;
+        if (cv_.wait_until(lk, next, [this] { return !running_; })) break;
+        sample();
+    }
+}
+
+void CpuSampler::sampleOnce() {
+    std::lock_guard<std::mutex> lk(mx_);
+    sample();
+}
+
+SampleSummary CpuSampler::drainSummary() {
+    std::lock_guard<std::mutex> lk(mx_);
+    return spikes_.drain();
+}
+
+void CpuSampler::cores(std::vector<CoreUsage>& out) const {
+    std::lock_guard<std::mutex> lk(mx_);
+    out = cores_;
+}
+
+namespace {
+float usage(const ProcStatReader::CpuTimes& now, const ProcStatReader::CpuTimes& then) {
+    const uint64_t dtotal = now.total - then.total;
+    const uint64_t didle = now.idle - then.idle;
+    if (now.total < then.total || dtotal == 0 || didle > dtotal) return -1;
+    float u = 100.0f * (float)(dtotal - didle) / (float)dtotal;
+    return u > 100 ? 100 : u;
+}
+}  // namespace
+
+// Called with mx_ held; compares the new reading with the oldest one kept
+void CpuSampler::sample() {
+    Sample& s = ring_[next_];  // reuses the slot's capacity
+    if (!stat_.readCpus(s)) return;
+
+    const Sample& prev = ring_[(next_ + ring_.size() - 1) % ring_.size()];
+    next_ = (next_ + 1) % ring_.size();
+    if (filled_ < ring_.size()) ++filled_;
+    if (filled_ < 2) return;
+
+    // usage since the previous reading, for the spike summary
+    const float instant = usage(s.front(), prev.front());
+    if (instant >= 0) spikes_.push(instant);
+
+    const Sample& oldest = ring_[filled_ < ring_.size() ? 0 : next_];
+    const float total = usage(s.front(), oldest.front());
+    if (total >= 0) percent_.store(total, std::memory_order_relaxed);
+
+    // Cores line up by position unless one went on- or offline in between
+    cores_.clear();
+    for (size_t i = 1; i < s.size(); ++i) {
+        const ProcStatReader::CpuTimes* then = nullptr;
+        if (i < oldest.size() && oldest[i].core == s[i].core) {
+            then = &oldest[i];
+        } else {
+            for (const auto& o : oldest)
+                if (o.core == s[i].core) then = &o;
+        }
+        if (!then) continue;
+        const float u = usage(s[i], *then);
+        if (u >= 0) cores_.push_back({s[i].core, u});
+    }
+}
@@ -0,0 +1,395 @@
+#include "../include/exec_engine.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+extern char** environ;
+
+namespace {
+constexpr size_t kReadChunk = 16 * 1024;
+// Poll period while something can only be retried (a refused chunk, or a
+// command that closed its pipes but has not exited yet)
+constexpr int kRetryMs = 20;
+
+void closeFd(int& fd) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+ExecEngine::Exit exitOf(int status) {
+    ExecEngine::Exit e;
+    if (WIFEXITED(status)) {
+        e.code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        e.signal = WTERMSIG(status);
+        e.code = 128 + e.signal;
+    } else {
+        e.code = 128;
+    }
+    return e;
+}
+
+// Forks "/bin/sh -c cmd" in its own process group; fills the read ends
+int spawnShell(const std::string& cmd, pid_t& pid, int fds[2]) {
+    int out[2], err[2];
+    if (::pipe2(out, O_CLOEXEC) != 0) return errno;
+    if (::pipe2(err, O_CLOEXEC) != 0) {
+        const int e = errno;
+        ::close(out[0]);
+        ::close(out[1]);
+        return e;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, out[1], 1);  // dup2 clears CLOEXEC
+    posix_spawn_file_actions_adddup2(&fa, err[1], 2);
+
+    // own process group, so the whole pipeline can be signalled at once;
+    // no signal blocked and SIGPIPE back to its default
+    posix_spawnattr_t at;
+    posix_spawnattr_init(&at);
+    posix_spawnattr_setflags(&at, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                      POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&at, 0);
+    sigset_t none, def;
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&at, &none);
+    sigemptyset(&def);
+    sigaddset(&def, SIGPIPE);
+    posix_spawnattr_setsigdefault(&at, &def);
+
+    char* argv[] = {const_cast<char*>("sh"), const_cast<char*>("-c"),
+                    const_cast<char*>(cmd.c_str()), nullptr};
+    const int rc = ::posix_spawn(&pid, "/bin/sh", &fa, &at, argv, environ);
+
+    posix_spawnattr_destroy(&at);
+    posix_spawn_file_actions_destroy(&fa);
+    ::close(out[1]);
+    ::close(err[1]);
+    if (rc != 0) {
+        ::close(out[0]);
+        ::close(err[0]);
+        return rc;
+    }
+    fds[0] = out[0];
+    fds[1] = err[0];
+    for (int i = 0; i < 2; ++i)
+        ::fcntl(fds[i], F_SETFL, ::fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+}  // namespace
+
+ExecEngine::ExecEngine(size_t maxRunning, size_t maxQueued,
+                       std::chrono::milliseconds killGrace)
+    : maxRunning_(std::max<size_t>(maxRunning, 1)),
+      maxQueued_(maxQueued),
+      killGrace_(killGrace),
+      wakeFd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+ExecEngine::~ExecEngine() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        stopping_ = true;
+    }
+    wake();
+    if (thr_.joinable()) thr_.join();
+
+    for (auto& [id, j] : jobs_) {
+        closeFd(j.fds[0]);
+        closeFd(j.fds[1]);
+        if (j.pid < 0 || j.reaped) continue;
+        ::kill(-j.pid, SIGKILL);
+        while (::waitpid(j.pid, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+    if (wakeFd_ >= 0) ::close(wakeFd_);
+}
+
+ExecEngine::Submit ExecEngine::submit(int id, std::string cmd, Sink sink, Options opt) {
+    std::lock_guard<std::mutex> lk(mx_);
+    if (jobs_.count(id) ||
+        std::any_of(queue_.begin(), queue_.end(), [id](const Queued& q) { return q.id == id; }))
+        return Submit::Duplicate;
+
+    Job j;
+    j.cmd = std::move(cmd);
+    j.sink = std::move(sink);
+    j.opt = opt;
+    j.credit = static_cast<int64_t>(opt.window);
+    j.since = clock::now();
+
+    Submit result = Submit::Started;
+    if (jobs_.size() >= maxRunning_) {
+        if (queue_.size() >= maxQueued_) return Submit::Full;
+        queue_.push_back({id, std::move(j)});
+        result = Submit::Queued;
+    } else {
+        start(j);
+        jobs_.emplace(id, std::move(j));
+    }
+
+    if (!thr_.joinable()) {
+        buf_.resize(kReadChunk);
+        thr_ = std::thread([this] { run(); });
+    }
+    wake();
+    return result;
+}
+
+void ExecEngine::start(Job& j) {
+    j.since = clock::now();
+    if (int rc = spawnShell(j.cmd, j.pid, j.fds)) {
+        errno = rc;
+        j.pid = -1;
+        j.reaped = true;
+        j.exit = Exit{127, 0};
+        return;
+    }
+    if (j.opt.timeout.count() > 0) j.deadline = j.since + j.opt.timeout;
+}
+
+void ExecEngine::grant(int id, size_t bytes) {
+    std::lock_guard<std::mutex> lk(mx_);
+    auto it = jobs_.find(id);
+    if (it != jobs_.end()) {
+        Job& j = it->second;
+        if (!j.opt.window) return;
+        const bool wasPaused = paused(j);
+        j.credit += static_cast<int64_t>(bytes);
+        if (wasPaused && !paused(j)) wake();
+        return;
+    }
+    for (auto& q : queue_)
+        if (q.id == id && q.job.opt.window) q.job.credit += static_cast<int64_t>(bytes);
+}
+
+bool ExecEngine::kill(int id) {
+    std::lock_guard<std::mutex> lk(mx_);
+    auto it = jobs_.find(id);
+    if (it != jobs_.end()) {
+        Job& j = it->second;
+        if (!finished(j) && j.killAt == clock::time_point::max())
+            terminate(j, Exit::Reason::Killed, clock::now());
+        wake();
+        return true;
+    }
+    auto q = std::find_if(queue_.begin(), queue_.end(),
+                          [id](const Queued& e) { return e.id == id; });
+    if (q == queue_.end()) return false;
+    // never started: reported as if SIGTERM had ended it
+    Job j = std::move(q->job);
+    queue_.erase(q);
+    j.reaped = true;
+    j.exit = Exit{128 + SIGTERM, SIGTERM, Exit::Reason::Killed};
+    jobs_.emplace(id, std::move(j));
+    wake();
+    return true;
+}
+
+void ExecEngine::list(std::vector<JobInfo>& out) const {
+    out.clear();
+    const auto now = clock::now();
+    auto info = [&](int id, const Job& j, bool running) {
+        JobInfo i;
+        i.id = static_cast<uint32_t>(id);
+        i.running = running;
+        i.pid = running ? static_cast<uint32_t>(j.pid) : 0;
+        i.age_ms = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - j.since).count());
+        i.bytes_out = j.bytes_out;
+        i.cmd = j.cmd;
+        return i;
+    };
+    std::lock_guard<std::mutex> lk(mx_);
+    for (const auto& [id, j] : jobs_)
+        if (j.pid > 0 && !j.abandoned && !finished(j)) out.push_back(info(id, j, true));
+    std::sort(out.begin(), out.end(),
+              [](const JobInfo& a, const JobInfo& b) { return a.id < b.id; });
+    for (const auto& q : queue_) out.push_back(info(q.id, q.job, false));
+}
+
+void ExecEngine::abandonAll() {
+    std::lock_guard<std::mutex> lk(mx_);
+    queue_.clear();
+    for (auto& [id, j] : jobs_) {
+        if (j.abandoned) continue;
+        j.abandoned = true;
+        j.sink = Sink{};
+        j.out.clear();
+        j.refused = false;
+        if (j.pid > 0 && !j.reaped) ::kill(-j.pid, SIGKILL);
+    }
+    wake();
+}
+
+size_t ExecEngine::size() const {
+    std::lock_guard<std::mutex> lk(mx_);
+    return jobs_.size() + queue_.size();
+}
+
+void ExecEngine::wake() {
+    if (wakeFd_ < 0) return;
+    const uint64_t one = 1;
+    (void)!::write(wakeFd_, &one, sizeof(one));
+}
+
+bool ExecEngine::paused(const Job& j) {
+    if (j.abandoned) return false;  // drained and discarded until EOF
+    return j.refused || (j.opt.window && j.credit <= 0);
+}
+
+bool ExecEngine::finished(const Job& j) {
+    return j.reaped && j.fds[0] < 0 && j.fds[1] < 0;
+}
+
+void ExecEngine::terminate(Job& j, Exit::Reason why, clock::time_point now) {
+    j.endReason = why;
+    j.deadline = clock::time_point::max();
+    j.killAt = now + killGrace_;
+    // The group outlives the shell while anything in it holds the pipes open
+    if (j.pid > 0 && !finished(j)) ::kill(-j.pid, SIGTERM);
+}
+
+ExecEngine::clock::time_point ExecEngine::checkTimers(Job& j, clock::time_point now) {
+    if (now >= j.deadline) terminate(j, Exit::Reason::TimedOut, now);
+    if (now >= j.killAt) {
+        if (j.pid > 0 && !finished(j)) ::kill(-j.pid, SIGKILL);
+        j.killAt = clock::time_point::max();
+    }
+    if (now >= j.outDue) flush(j);
+    return std::min({j.deadline, j.killAt, j.outDue});
+}
+
+bool ExecEngine::flush(Job& j) {
+    if (j.out.empty()) return true;
+    j.outDue = clock::time_point::max();
+    j.refused = !j.sink.output(j.outStream, j.out);
+    if (j.refused) return false;
+    j.out.clear();  // keeps its capacity for the next batch
+    return true;
+}
+
+void ExecEngine::readPipe(Job& j, int slot, clock::time_point now) {
+    const Stream s = slot == 0 ? Stream::Out : Stream::Err;
+    // a batch carries one stream: send the other one's first
+    if (!j.out.empty() && s != j.outStream && !flush(j)) return;
+
+    const ssize_t n = ::read(j.fds[slot], buf_.data(), buf_.size());
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EINTR) closeFd(j.fds[slot]);
+        return;
+    }
+    if (n == 0) {
+        closeFd(j.fds[slot]);
+        flush(j);  // nothing more is coming from this stream
+        return;
+    }
+    if (j.abandoned) return;
+
+    j.bytes_out += static_cast<uint64_t>(n);
+    if (j.opt.window) j.credit -= n;
+    if (j.out.empty()) {
+        j.outStream = s;
+        j.outDue = now + j.opt.flushDelay;
+    }
+    j.out.append(buf_.data(), static_cast<size_t>(n));
+    if (j.opt.flushDelay.count() <= 0 || j.out.size() >= j.opt.flushBytes) flush(j);
+}
+
+void ExecEngine::run() {
+    std::vector<pollfd> pfds;
+    std::vector<std::pair<int, int>> owners;  // job id and pipe slot per pollfd
+    std::unique_lock<std::mutex> lk(mx_);
+    while (!stopping_) {
+        // queued jobs take the slots freed since the last round
+        while (!queue_.empty() && jobs_.size() < maxRunning_) {
+            Queued q = std::move(queue_.front());
+            queue_.pop_front();
+            start(q.job);
+            jobs_.emplace(q.id, std::move(q.job));
+        }
+
+        pfds.clear();
+        owners.clear();
+        pfds.push_back({wakeFd_, POLLIN, 0});
+        owners.emplace_back(0, -1);
+        const auto now = clock::now();
+        auto next = clock::time_point::max();
+        bool retry = wakeFd_ < 0;
+        bool freed = false;
+
+        for (auto it = jobs_.begin(); it != jobs_.end();) {
+            Job& j = it->second;
+            if (j.refused && !flush(j)) retry = true;
+            next = std::min(next, checkTimers(j, now));
+
+            // finished once both pipes hit EOF and the child was reaped
+            const bool open = j.fds[0] >= 0 || j.fds[1] >= 0;
+            if (!open && !j.reaped) {
+                int status = 0;
+                const pid_t r = ::waitpid(j.pid, &status, WNOHANG);
+                if (r == j.pid || (r < 0 && errno == ECHILD)) {
+                    j.reaped = true;
+                    j.exit = r == j.pid ? exitOf(status) : Exit{128, 0};
+                    j.exit.reason = j.endReason;
+                } else {
+                    retry = true;  // closed its output but still running
+                }
+            }
+            if (!open && j.reaped && j.out.empty()) {
+                if (j.abandoned || j.sink.done(j.exit)) {
+                    it = jobs_.erase(it);
+                    freed = true;
+                    continue;
+                }
+                retry = true;
+            }
+
+            if (!paused(j)) {
+                for (int slot = 0; slot < 2; ++slot) {
+                    if (j.fds[slot] < 0) continue;
+                    pfds.push_back({j.fds[slot], POLLIN, 0});
+                    owners.emplace_back(it->first, slot);
+                }
+            }
+            ++it;
+        }
+        if (freed && !queue_.empty()) continue;
+
+        int timeout = retry ? kRetryMs : -1;
+        if (next != clock::time_point::max()) {
+            const auto ms =
+                std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1;
+            timeout = timeout < 0 ? static_cast<int>(ms)
+                                  : std::min(timeout, static_cast<int>(ms));
+        }
+
+        lk.unlock();
+        const int n = ::poll(pfds.data(), pfds.size(), timeout);
+        lk.lock();
+        if (n <= 0) continue;
+
+        if (pfds[0].revents) {
+            uint64_t v;
+            (void)!::read(wakeFd_, &v, sizeof(v));
+        }
+        for (size_t i = 1; i < pfds.size(); ++i) {
+            if (!pfds[i].revents) continue;
+            auto it = jobs_.find(owners[i].first);
+            // the pipe may have been closed while unlocked
+            if (it == jobs_.end() || it->second.fds[owners[i].second] != pfds[i].fd)
+                continue;
+            if (!paused(it->second)) readPipe(it->second, owners[i].second, clock::now());
+        }
+    }
+}
@@ -0,0 +1,154 @@
+#include "../include/host_sampler.h"
+
+using metric::makeId;
+
+namespace {
+uint64_t centi(float percent) {
+    return static_cast<uint64_t>(percent * 100.0f + 0.5f);
+}
+
+// Counters are cumulative; a smaller value means the device was reset
+uint64_t perSecond(uint64_t now, uint64_t then, double seconds) {
+    if (now < then || seconds <= 0) return 0;
+    return static_cast<uint64_t>(static_cast<double>(now - then) / seconds + 0.5);
+}
+
+template <typename C>
+const C* findByName(const std::vector<C>& v, const DevName& name) {
+    for (const auto& c : v)
+        if (c.name.view() == name.view()) return &c;
+    return nullptr;
+}
+
+template <typename C>
+struct RateField {
+    metric::Kind kind;
+    uint64_t C::*counter;
+    uint64_t unit;  // bytes per counted unit
+};
+
+using NetCounters = NetDevReader::Counters;
+using DiskCounters = DiskstatsReader::Counters;
+
+constexpr RateField<NetCounters> kNetRates[] = {
+    {metric::NET_RX_BYTES, &NetCounters::rxBytes, 1},
+    {metric::NET_TX_BYTES, &NetCounters::txBytes, 1},
+    {metric::NET_RX_PACKETS, &NetCounters::rxPackets, 1},
+    {metric::NET_TX_PACKETS, &NetCounters::txPackets, 1},
+};
+constexpr RateField<DiskCounters> kDiskRates[] = {
+    {metric::BLK_READ_BYTES, &DiskCounters::readSectors, 512},
+    {metric::BLK_WRITE_BYTES, &DiskCounters::writeSectors, 512},
+    {metric::BLK_READ_OPS, &DiskCounters::reads, 1},
+    {metric::BLK_WRITE_OPS, &DiskCounters::writes, 1},
+};
+
+// One metric per field and device seen in both readings, labelled by name
+template <typename C, size_t N>
+void addRates(MetricSet& m, const std::vector<C>& now, const std::vector<C>& then,
+              double seconds, const RateField<C> (&fields)[N]) {
+    for (const auto& f : fields) {
+        for (const auto& c : now) {
+            const C* p = findByName(then, c.name);
+            if (!p) continue;
+            m.set(makeId(f.kind, m.label(c.name.view())),
+                  perSecond(c.*f.counter, p->*f.counter, seconds) * f.unit);
+        }
+    }
+}
+}  // namespace
+
+HostSampler::HostSampler(CpuSampler& cpu, std::chrono::milliseconds interval)
+    : cpu_(cpu), interval_(interval) {}
+
+HostSampler::~HostSampler() { stop(); }
+
+void HostSampler::start() {
+    std::lock_guard<std::mutex> lk(mx_);
+    if (running_) return;
+    running_ = true;
+    sample();
+    thr_ = std::thread([this] { run(); });
+}
+
+void HostSampler::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thr_.joinable()) thr_.join();
+}
+
+std::shared_ptr<const MetricSet> HostSampler::latest() const {
+    std::lock_guard<std::mutex> lk(latestMx_);
+    return latest_;
+}
+
+void HostSampler::run() {
+    std::unique_lock<std::mutex> lk(mx_);
+    while (running_) {
+        if (cv_.wait_for(lk, interval_, [this] { return !running_; })) break;
+        sample();
+    }
+}
+
+void HostSampler::sample() {
+    auto m = std::make_shared<MetricSet>();
+    const auto now = Clock::now();
+
+    // Ids are appended in ascending order: kind by kind, instances in order
+    // CPU: the mean of the readings taken since the last sample, or the
+    // window average if there were none
+    const SampleSummary spikes = cpu_.drainSummary();
+    m->set(makeId(metric::CPU),
+           centi(spikes.count ? spikes.mean : cpu_.percent()));
+    uint64_t used = 0, total = 0;
+    if (meminfo_.read(used, total)) {
+        m->set(makeId(metric::MEM_USED), used);
+        m->set(makeId(metric::MEM_TOTAL), total);
+    }
+    // statvfs() figures are refreshed per mount at their own pace
+    const auto& mounts = mounts_.refresh();
+    for (const auto& mt : mounts) {
+        if (mt.point != "/" || !mt.measured) continue;
+        m->set(makeId(metric::DISK_USED), mt.used_kb);
+        m->set(makeId(metric::DISK_TOTAL), mt.total_kb);
+    }
+    uint64_t load[3];
+    if (loadavg_.read(load)) {
+        m->set(makeId(metric::LOAD1), load[0]);
+        m->set(makeId(metric::LOAD5), load[1]);
+        m->set(makeId(metric::LOAD15), load[2]);
+    }
+    cpu_.cores(cores_);
+    for (const auto& c : cores_)
+        m->set(makeId(metric::CORE_CPU, static_cast<uint16_t>(c.core)),
+               centi(c.percent));
+
+    // Rates need a previous reading: the first sample has none
+    const bool havePrev = prevAt_ != Clock::time_point{};
+    const double dt = std::chrono::duration<double>(now - prevAt_).count();
+    if (!netdev_.read(net_)) net_.clear();
+    if (!diskstats_.read(disk_)) disk_.clear();
+    if (havePrev) {
+        addRates(*m, net_, prevNet_, dt, kNetRates);
+        addRates(*m, disk_, prevDisk_, dt, kDiskRates);
+    }
+    for (const auto& mt : mounts)
+        if (mt.measured) m->set(makeId(metric::FS_USED, m->label(mt.point)), mt.used_kb);
+    for (const auto& mt : mounts)
+        if (mt.measured) m->set(makeId(metric::FS_TOTAL, m->label(mt.point)), mt.total_kb);
+    if (spikes.count) {
+        m->set(makeId(metric::CPU_MIN), centi(spikes.min));
+        m->set(makeId(metric::CPU_MAX), centi(spikes.max));
+        m->set(makeId(metric::CPU_P95), centi(spikes.p95));
+    }
+    prevNet_.swap(net_);
+    prevDisk_.swap(disk_);
+    prevAt_ = now;
+
+    std::lock_guard<std::mutex> lk(latestMx_);
+    latest_ = std::move(m);
+}
@@ -0,0 +1,221 @@
+#include "../include/mount_table.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <thread>
+
+#include "../include/proc_reader.h"
+#include "../include/system_helpers.h"
+
+namespace {
+// Filesystems with no storage of their own behind them
+constexpr std::string_view kPseudo[] = {
+    "autofs",   "binfmt_misc", "bpf",        "cgroup",     "cgroup2",
+    "configfs", "debugfs",     "devpts",     "devtmpfs",   "efivarfs",
+    "fusectl",  "hugetlbfs",   "mqueue",     "nsfs",       "proc",
+    "pstore",   "ramfs",       "rpc_pipefs", "securityfs", "selinuxfs",
+    "squashfs", "sysfs",       "tmpfs",      "tracefs",
+};
+
+constexpr std::string_view kRemote[] = {
+    "nfs", "nfs4", "cifs", "smb3", "ceph", "glusterfs", "9p", "fuse.sshfs",
+};
+
+template <size_t N>
+bool oneOf(std::string_view v, const std::string_view (&set)[N]) {
+    return std::find(std::begin(set), std::end(set), v) != std::end(set);
+}
+
+// mountinfo escapes space, tab, newline and backslash as \ooo
+std::string unescape(std::string_view v) {
+    std::string out;
+    out.reserve(v.size());
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (v[i] == '\\' && i + 3 < v.size()) {
+            const char a = v[i + 1], b = v[i + 2], c = v[i + 3];
+            if (a >= '0' && a <= '3' && b >= '0' && b <= '7' && c >= '0' && c <= '7') {
+                out.push_back(static_cast<char>((a - '0') * 64 + (b - '0') * 8 + (c - '0')));
+                i += 3;
+                continue;
+            }
+        }
+        out.push_back(v[i]);
+    }
+    return out;
+}
+
+struct Line {
+    std::string_view dev;    // "major:minor"
+    std::string_view root;   // path inside the filesystem that is mounted
+    std::string_view point;
+    std::string_view fstype;
+};
+
+// "id parent major:minor root point options [optional...] - fstype source superopts"
+bool parseLine(const char*& p, const char* end, Line& l) {
+    std::string_view f[6];
+    for (auto& x : f) x = procscan::nextToken(p, end);
+    if (f[5].empty()) return false;
+    l.dev = f[2];
+    l.root = f[3];
+    l.point = f[4];
+    for (;;) {
+        std::string_view t = procscan::nextToken(p, end);
+        if (t.empty()) return false;
+        if (t == "-") break;
+    }
+    l.fstype = procscan::nextToken(p, end);
+    return !l.fstype.empty();
+}
+}  // namespace
+
+MountTable::MountTable()
+    : fd_(::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC)), buf_(16384) {}
+
+MountTable::~MountTable() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+// The kernel flags mountinfo with POLLPRI|POLLERR after every mount or
+// unmount; poll() itself clears the flag
+bool MountTable::changed() {
+    if (fd_ < 0) return !parsed_;
+    pollfd pfd{fd_, POLLPRI, 0};
+    return ::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR));
+}
+
+void MountTable::parse() {
+    if (fd_ < 0) return;
+    // read it whole, growing the buffer when the table does not fit
+    size_t got = 0;
+    for (;;) {
+        ssize_t n = ::pread(fd_, buf_.data() + got, buf_.size() - got,
+                            static_cast<off_t>(got));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (n == 0) break;
+        got += static_cast<size_t>(n);
+        if (got == buf_.size()) buf_.resize(buf_.size() * 2);
+    }
+    ++parses_;
+
+    std::vector<Mount> next;
+    std::vector<Line> lines;
+    const char* p = buf_.data();
+    const char* end = p + got;
+    while (p < end) {
+        Line l;
+        const bool ok = parseLine(p, end, l);
+        procscan::nextLine(p, end);
+        // "/" is always kept, whatever its type: the root figures come from it
+        const bool root = l.point == "/";
+        if (!ok || (!root && oneOf(l.fstype, kPseudo))) continue;
+
+        // same device mounted again (bind mounts, btrfs subvolumes): "/"
+        // wins, then the mount of the filesystem's root, then the shortest
+        // mount point. A later "/" is mounted over an earlier one and
+        // replaces it.
+        auto dup = std::find_if(lines.begin(), lines.end(), [&](const Line& o) {
+            return o.dev == l.dev || (root && o.point == "/");
+        });
+        if (dup != lines.end()) {
+            bool better = root;
+            if (!root && dup->point != "/")
+                better = (l.root == "/") != (dup->root == "/")
+                             ? l.root == "/"
+                             : l.point.size() < dup->point.size();
+            if (better) {
+                Mount& m = next[static_cast<size_t>(dup - lines.begin())];
+                m.point = unescape(l.point);
+                m.fstype = std::string(l.fstype);
+                m.remote = oneOf(l.fstype, kRemote);
+                *dup = l;
+            }
+            continue;
+        }
+        lines.push_back(l);
+        Mount m;
+        m.point = unescape(l.point);
+        m.fstype = std::string(l.fstype);
+        m.remote = oneOf(l.fstype, kRemote);
+        next.push_back(std::move(m));
+    }
+
+    // mounts that survive keep their figures and schedule
+    for (auto& m : next) {
+        auto old = std::find_if(mounts_.begin(), mounts_.end(), [&](const Mount& o) {
+            return o.point == m.point && o.fstype == m.fstype;
+        });
+        if (old != mounts_.end()) m = std::move(*old);
+    }
+    mounts_ = std::move(next);
+    parsed_ = true;
+}
+
+const std::vector<MountTable::Mount>& MountTable::refresh() {
+    if (!parsed_ || changed()) parse();
+
+    const auto now = std::chrono::steady_clock::now();
+    for (auto& m : mounts_) {
+        if (m.probe) collectProbe(m);
+        // a remote statvfs() still in flight: keep the last figures
+        if (m.probe || now < m.nextStat) continue;
+        if (!m.remote || !startProbe(m, now)) stat(m, now);
+    }
+    return mounts_;
+}
+
+void MountTable::stat(Mount& m, std::chrono::steady_clock::time_point now) {
+    uint64_t used = 0, total = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    get_disk(used, total, m.point.c_str());
+    const auto took = std::chrono::steady_clock::now() - t0;
+    if (total > 0) {
+        m.used_kb = used;
+        m.total_kb = total;
+        m.measured = true;
+    }
+    m.nextStat = now + (took >= kSlowCall ? kSlowInterval : kLocalInterval);
+}
+
+bool MountTable::startProbe(Mount& m, std::chrono::steady_clock::time_point now) {
+    auto probe = std::make_shared<Probe>();
+    probe->started = now;
+    try {
+        // detached: a call that never returns must not block the agent's exit
+        std::thread([probe, point = m.point] {
+            uint64_t used = 0, total = 0;
+            get_disk(used, total, point.c_str());
+            std::lock_guard<std::mutex> lk(probe->mx);
+            probe->used_kb = used;
+            probe->total_kb = total;
+            probe->took = std::chrono::steady_clock::now() - probe->started;
+            probe->done = true;
+        }).detach();
+    } catch (const std::system_error&) {
+        return false;
+    }
+    m.probe = std::move(probe);
+    return true;
+}
+
+void MountTable::collectProbe(Mount& m) {
+    const auto probe = m.probe;  // the lock lives in the probe
+    std::lock_guard<std::mutex> lk(probe->mx);
+    if (!probe->done) return;
+    if (probe->total_kb > 0) {
+        m.used_kb = probe->used_kb;
+        m.total_kb = probe->total_kb;
+        m.measured = true;
+    }
+    m.nextStat = probe->started +
+                 (probe->took >= kSlowCall ? kSlowInterval : kRemoteInterval);
+    m.probe.reset();
+}
@@ -0,0 +1,195 @@
+#include "../include/proc_reader.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+ProcFile::~ProcFile() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+std::string_view ProcFile::read(char* buf, size_t cap) noexcept {
+    truncated_ = false;
+    if (fd_ < 0) {
+        fd_ = ::open(path_, O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) return {};
+    }
+    // /proc files are generated on read: loop until EOF or the buffer is full
+    size_t got = 0;
+    while (got < cap) {
+        ssize_t n = ::pread(fd_, buf + got, cap - got, static_cast<off_t>(got));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd_);
+            fd_ = -1;
+            return {};
+        }
+        if (n == 0) break;
+        got += static_cast<size_t>(n);
+    }
+    if (got == cap) {
+        // possibly cut short: keep whole lines only
+        truncated_ = true;
+        while (got > 0 && buf[got - 1] != '\n') --got;
+    }
+    return {buf, got};
+}
+
+std::string_view ProcFile::read(std::vector<char>& buf) noexcept {
+    for (;;) {
+        std::string_view text = read(buf.data(), buf.size());
+        if (!truncated_ || buf.size() >= kMaxSize) return text;
+        try {
+            buf.resize(buf.size() * 2);
+        } catch (...) {
+            return text;
+        }
+    }
+}
+
+bool ProcStatReader::readCpus(std::vector<CpuTimes>& out) noexcept {
+    out.clear();
+    std::string_view text = file_.read(buf_, sizeof(buf_));
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (procscan::consume(p, end, "cpu")) {
+        CpuTimes t{-1, 0, 0};
+        uint64_t core = 0;
+        if (p < end && procscan::isDigit(*p) && procscan::nextU64(p, end, core))
+            t.core = static_cast<int>(core);  // "cpuN"; the aggregate is "cpu "
+
+        // user nice system idle iowait irq softirq steal guest guest_nice
+        uint64_t v[10] = {};
+        size_t n = 0;
+        while (n < 10 && procscan::nextU64(p, end, v[n])) ++n;
+        if (n < 4) break;  // cut short by the buffer
+        t.idle = v[3] + v[4];
+        for (size_t i = 0; i < n; ++i) t.total += v[i];
+        out.push_back(t);
+        procscan::nextLine(p, end);
+    }
+    return !out.empty() && out.front().core < 0;
+}
+
+bool MeminfoReader::read(uint64_t& used_kb, uint64_t& total_kb) noexcept {
+    std::string_view text = file_.read(buf_, sizeof(buf_));
+    const char* p = text.data();
+    const char* end = p + text.size();
+    uint64_t memTotal = 0, memAvailable = 0;
+    bool haveTotal = false, haveAvail = false;
+    while (p < end && !(haveTotal && haveAvail)) {
+        if (procscan::consume(p, end, "MemTotal:"))
+            haveTotal = procscan::nextU64(p, end, memTotal);
+        else if (procscan::consume(p, end, "MemAvailable:"))
+            haveAvail = procscan::nextU64(p, end, memAvailable);
+        procscan::nextLine(p, end);
+    }
+    if (!haveTotal) {
+        used_kb = total_kb = 0;
+        return false;
+    }
+    total_kb = memTotal;
+    used_kb = (memAvailable > memTotal) ? 0 : (memTotal - memAvailable);
+    return true;
+}
+
+bool LoadavgReader::read(uint64_t (&centi)[3]) noexcept {
+    std::string_view text = file_.read(buf_, sizeof(buf_));
+    const char* p = text.data();
+    const char* end = p + text.size();
+    return procscan::nextCenti(p, end, centi[0]) &&
+           procscan::nextCenti(p, end, centi[1]) &&
+           procscan::nextCenti(p, end, centi[2]);
+}
+
+bool NetDevReader::read(std::vector<Counters>& out) noexcept {
+    out.clear();
+    std::string_view text = file_.read(buf_);
+    const char* p = text.data();
+    const char* end = p + text.size();
+    procscan::nextLine(p, end);  // two header lines
+    procscan::nextLine(p, end);
+    while (p < end) {
+        // "  eth0: rx_bytes rx_packets errs drop fifo frame compressed
+        //  multicast tx_bytes tx_packets ..."
+        while (p < end && *p == ' ') ++p;
+        const char* colon = p;
+        while (colon < end && *colon != ':' && *colon != '\n') ++colon;
+        if (colon == end || *colon != ':') break;
+        Counters c{};
+        c.name.assign({p, static_cast<size_t>(colon - p)});
+        p = colon + 1;
+        uint64_t v[10] = {};
+        size_t n = 0;
+        while (n < 10 && procscan::nextU64(p, end, v[n])) ++n;
+        procscan::nextLine(p, end);
+        if (n < 10 || c.name.view() == "lo") continue;
+        c.rxBytes = v[0];
+        c.rxPackets = v[1];
+        c.txBytes = v[8];
+        c.txPackets = v[9];
+        out.push_back(c);
+    }
+    return true;
+}
+
+namespace {
+bool isVirtualDisk(std::string_view name) {
+    return name.substr(0, 4) == "loop" || name.substr(0, 3) == "ram" ||
+           name.substr(0, 4) == "zram";
+}
+
+// The kernel's naming rule: "sda1" after "sda", but "nvme0n1p2" after
+// "nvme0n1" since a disk name ending in a digit takes a 'p' before the
+// partition number. So "nvme0n10", "dm-10" or "md127" are disks of their own
+bool isPartitionOf(std::string_view name, std::string_view disk) {
+    if (name.size() <= disk.size() || name.substr(0, disk.size()) != disk)
+        return false;
+    std::string_view rest = name.substr(disk.size());
+    if (procscan::isDigit(disk.back())) {
+        if (rest.front() != 'p') return false;
+        rest.remove_prefix(1);
+    }
+    if (rest.empty()) return false;
+    for (char c : rest)
+        if (!procscan::isDigit(c)) return false;
+    return true;
+}
+}  // namespace
+
+bool DiskstatsReader::read(std::vector<Counters>& out) noexcept {
+    out.clear();
+    std::string_view text = file_.read(buf_);
+    const char* p = text.data();
+    const char* end = p + text.size();
+    while (p < end) {
+        // major minor name reads merged sectors ms writes merged sectors ...
+        uint64_t major = 0, minor = 0;
+        if (!procscan::nextU64(p, end, major) || !procscan::nextU64(p, end, minor))
+            break;
+        std::string_view name = procscan::nextToken(p, end);
+        uint64_t v[7] = {};
+        size_t n = 0;
+        while (n < 7 && procscan::nextU64(p, end, v[n])) ++n;
+        procscan::nextLine(p, end);
+        if (n < 7 || name.empty() || isVirtualDisk(name)) continue;
+
+        bool partition = false;
+        for (const auto& d : out)
+            if (isPartitionOf(name, d.name.view())) {
+                partition = true;
+                break;
+            }
+        if (partition) continue;
+
+        Counters c{};
+        c.name.assign(name);
+        c.reads = v[0];
+        c.readSectors = v[2];
+        c.writes = v[4];
+        c.writeSectors = v[6];
+        out.push_back(c);
+    }
+    return true;
+}
@@ -0,0 +1,160 @@
+#include "../include/process_scanner.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "../include/proc_reader.h"
+
+namespace {
+struct PidStat {
+    std::string_view comm;
+    uint64_t ticks = 0;
+    uint64_t starttime = 0;
+    uint64_t rss_pages = 0;
+};
+
+// "pid (comm) state ppid ... utime(14) stime(15) ... starttime(22) vsize rss(24)"
+bool parseStat(std::string_view text, PidStat& st) {
+    // comm may contain spaces and parentheses: it ends at the last ')'
+    const size_t open = text.find('(');
+    const size_t close = text.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos ||
+        close < open)
+        return false;
+    st.comm = text.substr(open + 1, close - open - 1);
+
+    const char* p = text.data() + close + 1;
+    const char* end = text.data() + text.size();
+    procscan::nextToken(p, end);  // state (field 3)
+    uint64_t v = 0, utime = 0;
+    for (int field = 4; field <= 24; ++field) {
+        if (!procscan::nextU64(p, end, v)) {
+            // only ppid..tpgid (fields 4-8) can be negative ("-1")
+            if (p < end && *p == '-') {
+                procscan::nextToken(p, end);
+                continue;
+            }
+            return false;
+        }
+        switch (field) {
+            case 14: utime = v; break;
+            case 15: st.ticks = utime + v; break;
+            case 22: st.starttime = v; break;
+            case 24: st.rss_pages = v; break;
+            default: break;
+        }
+    }
+    return true;
+}
+
+bool isPid(const char* name) {
+    if (!*name) return false;
+    for (; *name; ++name)
+        if (!procscan::isDigit(*name)) return false;
+    return true;
+}
+}  // namespace
+
+ProcessScanner::ProcessScanner()
+    : dir_(::opendir("/proc")),
+      ticksPerSec_(std::max(1L, ::sysconf(_SC_CLK_TCK))),
+      pageKb_(std::max(1L, ::sysconf(_SC_PAGESIZE) / 1024)) {}
+
+ProcessScanner::~ProcessScanner() {
+    if (dir_) ::closedir(dir_);
+}
+
+void ProcessScanner::top(size_t n, SortBy by, std::vector<ProcInfo>& out) {
+    std::lock_guard<std::mutex> lk(mx_);
+    out.clear();
+    if (!dir_) return;
+
+    if (generation_ == 0) {
+        scan(by);  // baseline ticks for every pid
+        std::this_thread::sleep_for(kPrimeDelay);
+    }
+    scan(by);
+
+    n = std::min(n, candidates_.size());
+    auto higher = [](const Candidate& a, const Candidate& b) {
+        return a.key != b.key ? a.key > b.key : a.pid < b.pid;
+    };
+    if (n < candidates_.size())
+        std::nth_element(candidates_.begin(), candidates_.begin() + n,
+                         candidates_.end(), higher);
+    std::sort(candidates_.begin(), candidates_.begin() + n, higher);
+
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Entry& e = cache_[candidates_[i].pid];
+        ProcInfo p;
+        p.pid = candidates_[i].pid;
+        p.cpu_centi = e.cpu_centi;
+        p.rss_kb = e.rss_kb;
+        p.name = e.comm;
+        out.push_back(std::move(p));
+    }
+}
+
+void ProcessScanner::scan(SortBy by) {
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsedTicks =
+        std::chrono::duration<double>(now - lastScan_).count() * ticksPerSec_;
+    const bool haveBaseline = generation_ != 0 && elapsedTicks > 0;
+    lastScan_ = now;
+    ++generation_;
+    candidates_.clear();
+
+    char path[sizeof(dirent::d_name) + sizeof("/stat")];
+    char buf[1024];
+    ::rewinddir(dir_);
+    while (dirent* d = ::readdir(dir_)) {
+        if (!isPid(d->d_name)) continue;
+        std::snprintf(path, sizeof(path), "%s/stat", d->d_name);
+        const int fd = ::openat(::dirfd(dir_), path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;  // exited since readdir
+        ssize_t len;
+        do {
+            len = ::read(fd, buf, sizeof(buf));
+        } while (len < 0 && errno == EINTR);
+        ::close(fd);
+
+        PidStat st;
+        if (len <= 0 || !parseStat({buf, static_cast<size_t>(len)}, st)) continue;
+
+        const auto pid = static_cast<uint32_t>(std::strtoul(d->d_name, nullptr, 10));
+        auto [it, fresh] = cache_.try_emplace(pid);
+        Entry& e = it->second;
+        if (fresh || e.starttime != st.starttime) {
+            // new process (or a new one behind a reused pid): no baseline yet
+            e = Entry{};
+            e.starttime = st.starttime;
+        } else if (haveBaseline && st.ticks >= e.ticks) {
+            e.cpu_centi = static_cast<uint32_t>(
+                static_cast<double>(st.ticks - e.ticks) * 10000.0 / elapsedTicks + 0.5);
+        }
+        const size_t n = std::min(st.comm.size(), sizeof(e.comm) - 1);  // exec renames
+        std::memcpy(e.comm, st.comm.data(), n);
+        e.comm[n] = '\0';
+        e.ticks = st.ticks;
+        e.rss_kb = st.rss_pages * static_cast<uint64_t>(pageKb_);
+        e.seen = generation_;
+        candidates_.push_back(
+            {by == SortBy::Cpu ? e.cpu_centi : e.rss_kb, pid});
+    }
+
+    // forget pids that are gone
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (it->second.seen != generation_)
+            it = cache_.erase(it);
+        else
+            ++it;
+    }
+}
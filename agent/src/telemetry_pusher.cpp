@@ -0,0 +1,67 @@
+#include "../include/telemetry_pusher.h"
+
+#include "../../core/include/connection.h"
+#include "../../core/include/protocol.h"
+
+TelemetryPusher::~TelemetryPusher() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        stopping_ = true;
+        conn_ = nullptr;
+    }
+    cv_.notify_all();
+    if (thr_.joinable()) thr_.join();
+}
+
+void TelemetryPusher::subscribe(Connection& c, std::chrono::milliseconds interval,
+                                uint32_t keyframeEvery) {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        conn_ = &c;
+        interval_ = interval;
+        encoder_.emplace(keyframeEvery);
+        ++generation_;
+        if (!thr_.joinable()) thr_ = std::thread([this] { run(); });
+    }
+    cv_.notify_all();
+}
+
+void TelemetryPusher::unsubscribe() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        if (!conn_) return;
+        conn_ = nullptr;
+        encoder_.reset();
+        ++generation_;
+    }
+    cv_.notify_all();
+}
+
+void TelemetryPusher::run() {
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lk(mx_);
+    while (!stopping_) {
+        cv_.wait(lk, [this] { return stopping_ || conn_; });
+        if (stopping_) break;
+
+        const uint64_t gen = generation_;
+        auto next = clock::now();
+        std::string payload;
+        while (!stopping_ && generation_ == gen) {
+            // Sample without the lock so (un)subscribe never waits on it
+            lk.unlock();
+            auto m = source_();
+            lk.lock();
+            if (stopping_ || generation_ != gen) break;
+
+            if (m && encoder_->encode(*m, payload))
+                conn_->send(specula::CMD_TELEMETRY, payload, 0, specula::FLAG_BINARY);
+
+            // Fixed-rate schedule; skip ticks rather than bunch up after a stall
+            next += interval_;
+            const auto now = clock::now();
+            if (next < now) next = now + interval_;
+            cv_.wait_until(lk, next, [&] { return stopping_ || generation_ != gen; });
+        }
+    }
+}
@@ -8,6 +8,9 @@
 
 #include "server.h"
 #include "stats_repo.h"
+#include "reply_repo.h"
+#include "../../core/include/job_codec.h"
+#include "../../core/include/top_codec.h"
 
 /**
  * @class Console
@@ -24,8 +27,11 @@ public:
      * @param server Reference to the Server object.
      * @param repo Reference to the StatsRepo object.
      * @param cmdRepo Reference to the CmdRepo object.
+     * @param topRepo Reference to the TOP reply repo.
+     * @param jobRepo Reference to the EXEC_LIST reply repo.
      */
-    Console(Server& server, StatsRepo& repo, CmdRepo& cmdRepo);
+    Console(Server& server, StatsRepo& repo, CmdRepo& cmdRepo,
+            ReplyRepo<ProcInfo>& topRepo, ReplyRepo<JobInfo>& jobRepo);
 
     /**
      * @brief Read-eval-print loop for the console.
@@ -43,6 +49,8 @@ private:
     Server& server_; ///< Reference to the Server object.
     StatsRepo& statsRepo_; ///< Reference to the StatsRepo object.
     CmdRepo& cmdRepo_; ///< Reference to the CmdRepo object.
+    ReplyRepo<ProcInfo>& topRepo_; ///< Reference to the TOP reply repo.
+    ReplyRepo<JobInfo>& jobRepo_; ///< Reference to the EXEC_LIST reply repo.
 
     /**
      * @brief Install signal handlers for the console.
@@ -60,6 +68,14 @@ private:
      */
     void printStatus();
 
+    /**
+     * @brief Print every metric one agent reported (per core, per NIC, per
+     * block device, ...).
+     * 
+     * @param conn_id The connection whose metrics are printed.
+     */
+    void printStatusDetail(int conn_id);
+
     /**
      * @brief Run the status command at regular intervals.
      * 
@@ -84,6 +100,59 @@ private:
      */
     void runExec(bool all, int id, std::string& cmd);
 
+    /**
+     * @brief Print transport metrics of the connections.
+     * 
+     * Without a connection ID, prints one row per connection plus an
+     * aggregate row; with one, also prints its frames per command and its
+     * latency histograms.
+     * 
+     * @param conn_id The connection to detail, or 0 for the summary table.
+     */
+    void runMetrics(int conn_id);
+
+    /**
+     * @brief Print an agent's busiest processes.
+     * 
+     * Sends TOP to the agent and waits for its reply.
+     * 
+     * @param conn_id The connection to ask.
+     * @param n Number of processes.
+     * @param byMem Rank by resident memory instead of CPU.
+     */
+    void runTop(int conn_id, int n, bool byMem);
+
+    /**
+     * @brief Print one metric of an agent over the recent past.
+     * 
+     * Reads the controller's own history of the agent's reports (no request
+     * is sent); without a metric, lists the recorded series instead.
+     * 
+     * @param conn_id The connection to show.
+     * @param series Series name as in `status <conn_id>`, or empty.
+     * @param seconds How far back to look.
+     * @param step_s Width of one row, in seconds.
+     */
+    void runHistory(int conn_id, const std::string& series, int seconds, int step_s);
+
+    /**
+     * @brief Print an agent's running and queued exec jobs.
+     * 
+     * Sends EXEC_LIST to the agent and waits for its reply.
+     * 
+     * @param conn_id The connection to ask.
+     */
+    void runJobs(int conn_id);
+
+    /**
+     * @brief Ask an agent to kill one of its exec jobs.
+     * 
+     * @param conn_id The connection running the job.
+     * @param id The exec id of the job.
+     * @return true if the request was sent.
+     */
+    bool sendKill(int conn_id, int id);
+
     /**
      * @brief Sleep for the specified duration.
      * 
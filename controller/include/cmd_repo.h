@@ -5,9 +5,11 @@
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "output_ring.h"
 
 /**
  * @struct CmdRecord
@@ -23,17 +25,27 @@ struct CmdRecord {
 
     State state = State::Pending;
     int exit_code = -1;              // definido em Done
+    int exit_signal = 0;             // signal that killed it, 0 if it exited
+    std::string end_reason;          // "killed", "timeout", "busy", "disconnected" or empty
 
     // métricas/diagnóstico
     size_t bytes_out = 0;            // total recebido em EXEC_OUT
     size_t chunks_out = 0;           // qtde de chunks recebidos
+    size_t bytes_err = 0;            // part of bytes_out read from stderr
+
+    // flow control: EXEC_OUT credit granted to the agent
+    size_t credit_window = 0;        // 0 = stream without flow control
+    size_t credit_unacked = 0;       // bytes consumed, credit not returned yet
 
     std::chrono::steady_clock::time_point t_created{};
     std::chrono::steady_clock::time_point t_started{};
     std::chrono::steady_clock::time_point t_last_update{};
     std::chrono::steady_clock::time_point t_finished{};
 
-    std::string tail;
+    // retained output is [out_begin, out_end) in stream offsets; read it
+    // with CmdRepo::readOut()
+    size_t out_begin = 0;            // oldest byte still kept
+    size_t out_end = 0;              // bytes appended so far
 };
 
 
@@ -67,9 +79,12 @@ public:
      * @param conn_id The connection ID associated with the command.
      * @param cmd The command string.
      * @param monitor Whether the command should be monitored.
+     * @param credit_window EXEC_OUT credit granted with the EXEC, 0 if the
+     *        stream is not flow controlled.
      * @return int 
      */
-    int add(int id, int conn_id, std::string cmd, bool monitor);
+    int add(int id, int conn_id, std::string cmd, bool monitor,
+            size_t credit_window = 0);
 
     /**
      * @brief Marks a command as started.
@@ -84,18 +99,35 @@ public:
      *
      * @param id The unique ID of the command.
      * @param chunk The output chunk to append.
+     * @param err Whether the chunk came from the command's stderr; both
+     *        streams share the output buffer, in arrival order.
      * @return True if the output was successfully appended, false otherwise.
      */
-    bool appendOut(int id, const std::string& chunk);
+    bool appendOut(int id, std::string_view chunk, bool err = false);
+
+    /**
+     * @brief Takes the credit to return for a flow-controlled stream.
+     *
+     * Credit is returned in batches of half the window, so the agent gets
+     * one EXEC_CREDIT per half window consumed rather than one per chunk.
+     *
+     * @param id The unique ID of the command.
+     * @return Bytes to grant back to the agent, 0 if none are due yet.
+     */
+    size_t takeCredit(int id);
 
     /**
      * @brief Marks a command as completed.
      *
      * @param id The unique ID of the command.
      * @param exit_code The exit code of the command.
+     * @param exit_signal The signal that killed it, 0 if it exited.
+     * @param reason Why the agent ended it ("killed", "timeout", "busy"),
+     *        empty if it ran to completion.
      * @return True if the command was successfully marked as done, false otherwise.
      */
-    bool done(int id, int exit_code);
+    bool done(int id, int exit_code, int exit_signal = 0,
+              std::string_view reason = {});
 
     /**
      * @brief Retrieves a command record by its ID.
@@ -105,6 +137,22 @@ public:
      */
     std::optional<CmdRecord> get(int id) const;
 
+    /**
+     * @brief Copies a command's retained output from @p offset on.
+     *
+     * Followers pass back the returned offset on the next call and so only
+     * ever copy new bytes; get() carries no output, only out_begin/out_end.
+     *
+     * @param id The unique ID of the command.
+     * @param offset Stream offset to read from; bytes before out_begin are
+     *        gone and are skipped.
+     * @param out Receives the bytes (appended).
+     * @param max_bytes Upper bound on the bytes copied.
+     * @return Offset just past the copied bytes, or nullopt if not found.
+     */
+    std::optional<size_t> readOut(int id, size_t offset, std::string& out,
+                                  size_t max_bytes = SIZE_MAX) const;
+
     /**
      * @brief Erases a command record by its ID.
      *
@@ -135,6 +183,15 @@ public:
      */
     size_t removeByConn(int conn_id);
 
+    /**
+     * @brief Marks every unfinished command of a connection as done.
+     *
+     * @param conn_id The connection that went away.
+     * @param reason Recorded as end_reason; exit_code is set to -1.
+     * @return size_t Number of commands finished.
+     */
+    size_t finishByConn(int conn_id, std::string_view reason);
+
     /**
      * @brief Clear done older than
      * 
@@ -153,10 +210,14 @@ public:
 private:
     int makeId_();
 
+    struct Entry {
+        CmdRecord rec;
+        OutputRing out;
+    };
+
     mutable std::mutex mx_;
-    std::unordered_map<int, CmdRecord> by_id_;
+    std::unordered_map<int, Entry> by_id_;
     std::atomic<int> next_id_{1};
 
     size_t tail_limit_;
-    void trimTail_(CmdRecord& r);
 };
@@ -1,8 +1,13 @@
 #pragma once
 #include "../../core/include/connection.h"
+#include "../../core/include/dispatch_table.h"
 #include "../../core/include/protocol.h"
 #include "stats_repo.h"
 #include "cmd_repo.h"
+#include "reply_repo.h"
+#include "../../core/include/job_codec.h"
+#include "../../core/include/top_codec.h"
+#include <memory>
 #include <string>
 
 /**
@@ -17,80 +22,133 @@ public:
      * 
      * @param statsRepo Reference to the StatsRepo object for statistics management.
      * @param cmdRepo Reference to the CmdRepo object for command management.
+     * @param topRepo Reference to the ReplyRepo receiving TOP replies.
+     * @param jobRepo Reference to the ReplyRepo receiving EXEC_LIST replies.
      * @param token A string token used for authentication or identification purposes.
      */
-    CommandRegistry(StatsRepo& statsRepo, CmdRepo& cmdRepo, const std::string& token);
+    CommandRegistry(StatsRepo& statsRepo, CmdRepo& cmdRepo,
+                    ReplyRepo<ProcInfo>& topRepo, ReplyRepo<JobInfo>& jobRepo,
+                    const std::string& token);
 
     /**
      * @brief Attach the command registry to a connection.
      * 
-     * This method registers all the necessary commands (e.g., Auth, Ping, Pong, Status, Bye, ExecOut, ExecDone)
-     * to the given connection.
+     * The handlers of all commands (e.g., Auth, Ping, Pong, Status, Bye, ExecOut, ExecDone)
+     * are built once, in the constructor; this only points the connection at that shared table.
      * 
      * @param c Reference to the Connection object to which the commands will be attached.
      */
     void attach(Connection& c);
 
+    /**
+     * @brief Drop the state kept for a connection that closed.
+     * 
+     * Its stats, history and TOP/EXEC_LIST replies are removed, and its commands
+     * still running are marked done with reason "disconnected" so consoles
+     * waiting on them return. Their records are kept until purge().
+     * 
+     * @param conn_id Id of the closed connection.
+     */
+    void detach(int conn_id);
+
+    /**
+     * @brief Remove the command records of a connection detached earlier.
+     * 
+     * @param conn_id Id of the closed connection.
+     */
+    void purge(int conn_id);
+
 private:
     StatsRepo& statsRepo_; ///< Reference to the StatsRepo object.
     CmdRepo& cmdRepo_; ///< Reference to the CmdRepo object.
+    ReplyRepo<ProcInfo>& topRepo_; ///< Reference to the TOP reply repo.
+    ReplyRepo<JobInfo>& jobRepo_; ///< Reference to the EXEC_LIST reply repo.
     std::string token_; ///< The token string.
+    std::shared_ptr<const DispatchTable> table_; ///< Handlers shared by all connections.
+
+    /**
+     * @brief Register the Auth command in the table.
+     * 
+     * @param t Table being built.
+     */
+    void registerAuth_(DispatchTable& t);
+
+    /**
+     * @brief Register the Ping command in the table.
+     * 
+     * @param t Table being built.
+     */
+    void registerPing_(DispatchTable& t);
+
+    /**
+     * @brief Register the Pong command in the table.
+     * 
+     * @param t Table being built.
+     */
+    void registerPong_(DispatchTable& t);
+
+    /**
+     * @brief Register the Status command in the table.
+     * 
+     * @param t Table being built.
+     */
+    void registerStatus_(DispatchTable& t);
 
     /**
-     * @brief Register the Auth command for the connection.
+     * @brief Register the Telemetry command (pushed samples) in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerAuth_(Connection& c);
+    void registerTelemetry_(DispatchTable& t);
 
     /**
-     * @brief Register the Ping command for the connection.
+     * @brief Register the Top command (process top replies) in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerPing_(Connection& c);
+    void registerTop_(DispatchTable& t);
 
     /**
-     * @brief Register the Pong command for the connection.
+     * @brief Register the ExecList command (job list replies) in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerPong_(Connection& c);
+    void registerExecList_(DispatchTable& t);
 
     /**
-     * @brief Register the Status command for the connection.
+     * @brief Register the Err command (errors reported by agents) in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerStatus_(Connection& c);
+    void registerErr_(DispatchTable& t);
 
     /**
-     * @brief Register the Bye command for the connection.
+     * @brief Register the Bye command in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerBye_(Connection& c);
+    void registerBye_(DispatchTable& t);
 
     /**
-     * @brief Register the ExecOut command for the connection.
+     * @brief Register the ExecOut command in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerExecOut_(Connection& c);
+    void registerExecOut_(DispatchTable& t);
 
     /**
-     * @brief Register the ExecDone command for the connection.
+     * @brief Register the ExecDone command in the table.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerExecDone_(Connection& c);
+    void registerExecDone_(DispatchTable& t);
 
     /**
-     * @brief Register a default command for the connection.
+     * @brief Register the default handler in the table.
      * 
      * This method is called when no specific command matches the incoming request.
      * 
-     * @param c Reference to the Connection object.
+     * @param t Table being built.
      */
-    void registerDefault_(Connection& c);
+    void registerDefault_(DispatchTable& t);
 };
@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../../core/include/metric_set.h"
+
+/**
+ * @brief Fixed-capacity time series of one agent's metrics.
+ *
+ * Samples go into a ring of `capacity` slots stored column-wise: one array of
+ * timestamps and, per series, one array of values indexed by the same slot.
+ * A range scan over one metric therefore walks two contiguous arrays and
+ * never touches the others. Series are keyed by MetricSet::nameOf()
+ * ("cpu", "net_rx_bytes[eth0]"), which stays stable when the agent's label
+ * table is renumbered; a series absent from a sample holds kMissing there.
+ *
+ * Memory is capacity * (8 + 8 * series) bytes, allocated as series appear
+ * and bounded by maxSeries. Not thread-safe; StatsRepo serialises access.
+ */
+class MetricHistory {
+   public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr uint64_t kMissing = UINT64_MAX;
+
+    /// One bucket of a query, in the metric's real unit (see KindInfo::scale).
+    struct Point {
+        clock::time_point t;  ///< Bucket start.
+        uint32_t count = 0;   ///< Samples in the bucket.
+        double min = 0, mean = 0, max = 0;
+    };
+
+    /**
+     * @param capacity Samples kept; the oldest is overwritten once full.
+     * @param maxSeries Series tracked; metrics beyond it are not recorded.
+     */
+    explicit MetricHistory(size_t capacity, size_t maxSeries = 256);
+
+    /// Records @p m as the sample taken at @p t (t must not go backwards).
+    void append(clock::time_point t, const MetricSet& m);
+
+    /**
+     * @brief Aggregates @p series over [from, to] into buckets of @p step
+     * starting at @p from; buckets without samples are left out.
+     * @return false if the series is unknown.
+     */
+    bool query(std::string_view series, clock::time_point from, clock::time_point to,
+               std::chrono::milliseconds step, std::vector<Point>& out) const;
+
+    /// Names of the recorded series, in first-seen order.
+    const std::vector<std::string>& series() const noexcept { return names_; }
+
+    size_t size() const noexcept { return size_; }
+    size_t capacity() const noexcept { return cap_; }
+    /// Bytes held by the ring's columns.
+    size_t memoryBytes() const noexcept {
+        return (ts_.capacity() + values_.capacity()) * sizeof(uint64_t);
+    }
+
+   private:
+    static constexpr uint32_t kNoSeries = UINT32_MAX;
+
+    // Column of @p id in the sample @p m; kNoSeries past maxSeries. idCache_
+    // must already match m.labels() (append() checks it once per sample)
+    uint32_t seriesOf(uint32_t id, const MetricSet& m);
+    // Physical slot of the i-th oldest sample
+    size_t slot(size_t i) const noexcept { return (head_ + cap_ - size_ + i) % cap_; }
+
+    size_t cap_;
+    size_t maxSeries_;
+    size_t head_ = 0;  // next slot written
+    size_t size_ = 0;
+
+    std::vector<int64_t> ts_;      // steady clock, ms
+    std::vector<uint64_t> values_;  // series s occupies [s * cap_, (s + 1) * cap_)
+    std::vector<std::string> names_;
+    std::vector<uint32_t> scales_;
+    std::unordered_map<std::string, uint32_t> byName_;
+
+    // id -> column for the label table last seen, sorted by id
+    std::vector<std::string> lastLabels_;
+    std::vector<std::pair<uint32_t, uint32_t>> idCache_;
+};
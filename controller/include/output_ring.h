@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Bounded byte stream addressed by absolute offsets.
+ *
+ * Holds the last `limit` bytes of a command's output in fixed-size blocks.
+ * Every byte keeps the offset it was appended at (bytes since the start of
+ * the stream), so a reader remembers where it stopped and later asks only
+ * for what came after. Appending copies the chunk into the newest blocks and
+ * trimming drops whole blocks from the front, so neither moves retained
+ * bytes. One dropped block is kept for reuse, which makes a steady stream
+ * allocation-free.
+ *
+ * Not thread-safe; CmdRepo serialises access.
+ */
+class OutputRing {
+   public:
+    static constexpr size_t kBlockSize = 4096;
+
+    /// @param limit Bytes retained; older ones are dropped (0 keeps none).
+    explicit OutputRing(size_t limit);
+
+    OutputRing(OutputRing&&) noexcept = default;
+    OutputRing& operator=(OutputRing&&) noexcept = default;
+
+    void append(std::string_view data);
+
+    /**
+     * @brief Appends to @p out the retained bytes at or after @p offset, at
+     * most @p max of them.
+     * @return Offset just past the copied bytes. It exceeds
+     *         offset + copied when the bytes from @p offset were already
+     *         dropped and the read skipped ahead to begin().
+     */
+    size_t read(size_t offset, std::string& out, size_t max = SIZE_MAX) const;
+
+    /// Calls @p fn(std::string_view) for each contiguous span from @p offset.
+    template <class Fn>
+    size_t forEach(size_t offset, size_t max, Fn&& fn) const;
+
+    /// Offset of the oldest retained byte.
+    size_t begin() const noexcept { return head_; }
+    /// Offset one past the newest byte (total bytes ever appended).
+    size_t end() const noexcept { return end_; }
+    size_t size() const noexcept { return end_ - head_; }
+
+    /// Changes the limit, dropping bytes that no longer fit.
+    void setLimit(size_t limit);
+
+   private:
+    using Block = std::unique_ptr<char[]>;
+
+    void trim_();
+
+    size_t limit_;
+    size_t base_ = 0;  // offset of blocks_.front()[0]; a multiple of kBlockSize
+    size_t head_ = 0;  // first retained byte, in [base_, base_ + kBlockSize)
+    size_t end_ = 0;
+    std::deque<Block> blocks_;
+    Block spare_;
+};
+
+template <class Fn>
+size_t OutputRing::forEach(size_t offset, size_t max, Fn&& fn) const {
+    size_t pos = offset < head_ ? head_ : offset;
+    while (pos < end_ && max > 0) {
+        const size_t rel = pos - base_;
+        const size_t in = rel % kBlockSize;
+        const size_t n = std::min({kBlockSize - in, end_ - pos, max});
+        fn(std::string_view(blocks_[rel / kBlockSize].get() + in, n));
+        pos += n;
+        max -= n;
+    }
+    return pos;
+}
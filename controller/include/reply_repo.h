@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Latest reply of each connection to a request such as TOP
+ * (ReplyRepo<ProcInfo>) or EXEC_LIST (ReplyRepo<JobInfo>).
+ *
+ * Every reply bumps a per-connection version, so a caller that sent the
+ * request can wait for the answer to arrive rather than sleeping a fixed time.
+ */
+template <typename T>
+class ReplyRepo {
+public:
+    /**
+     * @brief Stores @p items as the latest reply of @p conn_id and wakes waiters.
+     */
+    void put(int conn_id, std::vector<T> items) {
+        {
+            std::lock_guard<std::mutex> lk(mx_);
+            Reply& r = by_conn_[conn_id];
+            ++r.version;
+            r.items = std::move(items);
+        }
+        cv_.notify_all(); // Wake callers waiting for this reply
+    }
+
+    /**
+     * @brief Current version of @p conn_id's reply (0 before the first one).
+     */
+    uint64_t version(int conn_id) const {
+        std::lock_guard<std::mutex> lk(mx_);
+        auto it = by_conn_.find(conn_id);
+        return it == by_conn_.end() ? 0 : it->second.version;
+    }
+
+    /**
+     * @brief Waits until @p conn_id has a reply newer than @p version.
+     * @return The reply, or std::nullopt on timeout.
+     */
+    std::optional<std::vector<T>> waitNewer(int conn_id, uint64_t version,
+                                            std::chrono::milliseconds timeout) const {
+        std::unique_lock<std::mutex> lk(mx_);
+        auto newer = [&] {
+            auto it = by_conn_.find(conn_id);
+            return it != by_conn_.end() && it->second.version > version;
+        };
+        if (!cv_.wait_for(lk, timeout, newer)) return std::nullopt;
+        return by_conn_.find(conn_id)->second.items;
+    }
+
+    void removeByConnId(int conn_id) {
+        std::lock_guard<std::mutex> lk(mx_);
+        by_conn_.erase(conn_id);
+    }
+
+private:
+    struct Reply {
+        uint64_t version = 0;
+        std::vector<T> items;
+    };
+
+    mutable std::mutex mx_;
+    mutable std::condition_variable cv_;
+    std::unordered_map<int, Reply> by_conn_;
+};
@@ -1,10 +1,16 @@
 #pragma once
-#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <thread>
 #include <unordered_map>
-#include <mutex>
+#include <vector>
+
+#include "../../core/include/worker_pool.h"
 
 /**
  * @file scheduler.h
@@ -13,7 +19,19 @@
 
 /**
  * @class Scheduler
- * @brief Manages the scheduling and execution of periodic tasks.
+ * @brief Manages the scheduling and execution of periodic and one-shot tasks.
+ *
+ * Deadlines are kept in a min-heap and the scheduler thread sleeps on a
+ * condition variable until the earliest one, so an idle scheduler does not
+ * wake at all. Due jobs are handed to a WorkerPool and run without any
+ * scheduler lock held, so a slow job delays neither other timers nor
+ * every()/cancel() callers. A periodic job is re-armed when its run ends,
+ * so it never overlaps itself.
+ *
+ * cancel() only erases the job from a hash map; its heap entry is skipped
+ * when it comes up and the heap is compacted once such entries are the
+ * majority, which keeps tens of thousands of timers (e.g. one per agent)
+ * cheap to add and cancel.
  */
 class Scheduler {
 public:
@@ -22,56 +40,118 @@ public:
 
     /**
      * @brief Constructs a Scheduler and starts its loop.
+     *
+     * @param pool Pool running the jobs; must outlive the Scheduler.
      */
-    Scheduler();
+    explicit Scheduler(WorkerPool& pool = WorkerPool::shared());
 
     /**
      * @brief Destroys the Scheduler and stops its loop.
      */
     ~Scheduler();
 
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
     /**
      * @brief Schedules a job to run periodically.
      *
      * @param interval The interval between job executions.
      * @param job The job to execute.
+     * @param jitter Each run is delayed by a random amount up to this much,
+     *        so timers created together (e.g. per agent) do not fire together.
      * @return An ID representing the scheduled job.
      */
-    int every(ms interval, Job job);
+    int every(ms interval, Job job, ms jitter = ms(0));
+
+    /**
+     * @brief Schedules a job to run once.
+     *
+     * @param delay Time until the job runs.
+     * @param job The job to execute.
+     * @return An ID representing the scheduled job, valid until it runs.
+     */
+    int after(ms delay, Job job);
 
     /**
-     * @brief Cancels a scheduled job.
+     * @brief Cancels a scheduled job. A run already started completes, but
+     * is not followed by another.
      *
      * @param id The ID of the job to cancel.
      */
     void cancel(int id);
 
     /**
-     * @brief Stops the Scheduler and clears all scheduled jobs.
+     * @brief Stops the Scheduler, waits for running jobs and clears all
+     * scheduled jobs.
      */
     void stop();
 
+    /**
+     * @brief Number of scheduled jobs.
+     */
+    size_t size() const;
+
 private:
+    using clock = std::chrono::steady_clock;
+
     /**
      * @struct Item
      * @brief Represents a scheduled job.
      */
     struct Item {
-        int id; ///< The unique ID of the job.
-        ms interval; ///< The interval between job executions.
-        Job job; ///< The job to execute.
-        std::chrono::steady_clock::time_point next; ///< The next execution time.
-        bool active; ///< Whether the job is active.
+        ms interval; ///< The interval between job executions, 0 for a one-shot job.
+        ms jitter; ///< Upper bound of the random delay added to each run.
+        std::shared_ptr<const Job> job; ///< The job to execute, shared with its running task.
+        clock::time_point base; ///< Time of the pending or running run, before jitter.
+        bool armed; ///< Whether the job has an entry in the heap (false while it runs).
+    };
+
+    /**
+     * @struct Deadline
+     * @brief Heap entry; stale once its job is cancelled.
+     */
+    struct Deadline {
+        clock::time_point due; ///< When the job is due.
+        int id; ///< The job it belongs to.
+        bool operator>(const Deadline& o) const { return due > o.due; }
     };
 
+    WorkerPool& pool_; ///< Pool running the jobs.
     std::unordered_map<int, Item> items_; ///< Map of scheduled jobs by ID.
-    std::mutex mx_; ///< Mutex for thread-safe access to items.
-    std::atomic<bool> running_{true}; ///< Flag indicating whether the Scheduler is running.
-    std::thread thr_; ///< The thread running the Scheduler loop.
+    std::vector<Deadline> heap_; ///< Min-heap of deadlines (std::greater).
+    size_t stale_ = 0; ///< Heap entries whose job was cancelled.
+    size_t inFlight_ = 0; ///< Jobs handed to the pool and not finished yet.
+    std::minstd_rand rng_; ///< Jitter source.
+    mutable std::mutex mx_; ///< Mutex for thread-safe access to the above.
+    std::condition_variable cv_; ///< Wakes the loop (earlier deadline, stop) and stop() (job done).
+    bool running_ = true; ///< Flag indicating whether the Scheduler is running.
     int next_id_ = 1; ///< The next job ID to assign.
+    std::thread thr_; ///< The thread running the Scheduler loop.
 
     /**
      * @brief The main loop of the Scheduler.
      */
     void loop_();
+
+    /**
+     * @brief Adds a job due after @p delay; called with mx_ held.
+     */
+    int add_(ms delay, ms interval, ms jitter, Job job);
+
+    /**
+     * @brief Pushes a deadline for @p id, waking the loop if it is the
+     * earliest; called with mx_ held.
+     */
+    void arm_(int id, clock::time_point due);
+
+    /**
+     * @brief Runs job @p id on the pool, then re-arms it if it is periodic.
+     */
+    void dispatch_(int id, const std::shared_ptr<const Job>& job);
+
+    /**
+     * @brief Random delay in [0, @p jitter]; called with mx_ held.
+     */
+    ms jitter_(ms jitter);
 };
@@ -2,10 +2,13 @@
 #include "../../core/include/tcp_listener.h"
 #include "../../core/include/tcp_socket.h"
 #include "../../core/include/connection.h"
+#include "../../core/include/event_loop.h"
 #include "command_registry.h"
-#include "../include/thread_safe_vector.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -13,6 +16,8 @@
 #include <optional>
 #include <string>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 /**
  * @file server.h
@@ -22,6 +27,14 @@
 /**
  * @class Server
  * @brief Manages client connections and facilitates message broadcasting.
+ *
+ * Connections are kept in a table keyed by a connection id assigned from a
+ * counter at accept time, so an id is never reused the way fds are; it is
+ * what Connection::getId() returns and what the repos and the CLI call
+ * conn_id. When an agent goes away, its connection queues its id for a
+ * reaper thread, which stops it, removes it from the table and has the
+ * registry drop the agent's state (CommandRegistry::detach()); the records
+ * of its commands are purged some minutes later.
  */
 class Server {
 public:
@@ -40,8 +53,11 @@ public:
      * @brief Constructor for Server class.
      *
      * @param registry Command registry for managing commands.
+     * @param ioThreads Number of epoll event-loop threads multiplexing the
+     *        listener and all connections. 0 falls back to one accept thread
+     *        plus one reader thread per connection.
      */
-    explicit Server(CommandRegistry& registry);
+    explicit Server(CommandRegistry& registry, size_t ioThreads = 2);
 
     /**
      * @brief Destructor for Server class.
@@ -88,11 +104,17 @@ public:
      */
     template<typename F>
     void forEachConn(F&& f){
-        conns_.for_each([&](auto& sp){
-            if (sp && sp->isRunning()) f(*sp);
-        });
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        for (auto& [id, e] : conns_)
+            if (e.conn->isRunning()) f(*e.conn);
     }
 
+    /**
+     * @brief Number of connections in the table, including closed ones the
+     * reaper has not removed yet.
+     */
+    size_t connectionCount() const;
+
     // -------------------- NOVO: APIs de endpoint --------------------
 
     /**
@@ -103,29 +125,51 @@ public:
     std::optional<Endpoint> getEndpoint(int conn_id) const;
 
     /**
-     * @brief Lista endpoints de todas as conexões ativas (apenas as que estão rodando).
+     * @brief Lista endpoints de todas as conexões ativas (apenas as que estão rodando),
+     * por conn_id.
      */
     std::vector<std::pair<int, Endpoint>> listEndpoints() const;
 
 private:
+    using clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::shared_ptr<Connection> conn;
+        std::optional<Endpoint> ep;  ///< Endpoints da conexão, resolvidos no accept.
+    };
+
     // Preenche Endpoint a partir de um fd (chamado no accept).
     static std::optional<Endpoint> resolveEndpointFromFd(int fd);
 
-    // Registra/atualiza o endpoint (chamado após aceitar uma conexão).
-    void setEndpoint(int conn_id, Endpoint ep);
+    // Connection of @p conn_id, or null; the table lock is not held afterwards.
+    std::shared_ptr<Connection> find_(int conn_id) const;
+
+    // Accepts every pending connection on the non-blocking listener (event loop mode).
+    void acceptPending_();
+
+    // Wires a freshly accepted fd into a Connection and registers it.
+    void onAccepted_(int cfd);
 
-    // Remove endpoint do mapa (em stop() e quando a conexão encerrar).
-    void eraseEndpoint(int conn_id);
+    // Close hook of a connection: queues it for the reaper (runs on its I/O loop).
+    void onClosed_(int conn_id);
+
+    // Reaper thread: stops and unregisters closed connections, purges old records.
+    void reap_();
 
 private:
     CommandRegistry& registry_; ///< Command registry for managing commands.
     TcpListener listener_; ///< TCP listener for accepting client connections.
     std::atomic<bool> running_{false}; ///< Flag indicating whether the server is running.
-    std::thread accept_thr_; ///< Thread for accepting incoming connections.
-    ThreadSafeVector<Connection> conns_; ///< Thread-safe vector of active client connections.
-    int next_id_{1}; ///< ID to be assigned to the next new connection.
-
-    // ---- NOVO: índice conn_id -> Endpoint ----
-    mutable std::mutex ep_mtx_;
-    std::unordered_map<int, Endpoint> endpoints_;
+    std::thread accept_thr_; ///< Thread for accepting incoming connections (thread mode).
+    std::unique_ptr<EventLoopGroup> loops_; ///< I/O loops (event loop mode), null in thread mode.
+    int next_id_{1}; ///< ID to be assigned to the next new connection (accepting thread only).
+
+    mutable std::mutex conns_mtx_;
+    std::unordered_map<int, Entry> conns_; ///< conn_id -> connection, until reaped.
+
+    std::mutex reap_mtx_;
+    std::condition_variable reap_cv_;
+    std::deque<int> closed_; ///< Closed connections waiting for the reaper.
+    std::deque<std::pair<clock::time_point, int>> purge_; ///< Reaped ids, purge due time first.
+    std::thread reaper_thr_;
 };
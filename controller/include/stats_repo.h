@@ -1,26 +1,90 @@
 #pragma once
+#include <array>
+#include <chrono>
 #include <cstdint>
-#include <vector>
+#include <memory>
 #include <mutex>
-#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../../core/include/metric_set.h"
+#include "metric_history.h"
 
 struct Stats {
     int         conn_id;
-    float       cpu_percent;
-    uint64_t    mem_used_bytes;
-    uint64_t    mem_total_bytes;
-    uint64_t    disk_used_bytes;
-    uint64_t    disk_total_bytes;
+    MetricSet   metrics;    // id/value pairs as reported by the agent, see metric_set.h
 };
 
+/**
+ * @brief Latest stats and history of each connection.
+ *
+ * Stats are published as immutable shared_ptr<const Stats>: upsert() builds
+ * the new value, then swaps the pointer in the agent's slot, and readers only
+ * copy pointers, so a reader rendering the dashboard never waits for ingest
+ * to build or record a report. The slots are indexed by conn_id in a fixed
+ * number of shards, each an unordered_map published the same way and copied
+ * only when one of its agents appears or is removed. Updating a known agent
+ * is a hash lookup, an append under the agent's own history lock (contended
+ * only by a history query on that agent) and a pointer swap. The pointer
+ * loads and stores are std::atomic_load/atomic_store, which libstdc++ guards
+ * with an internal lock pool held only for the pointer copy.
+ */
 class StatsRepo {
 public:
-    void upsert(const Stats& s);
+    using StatsPtr = std::shared_ptr<const Stats>;
+
+    /**
+     * @param historySamples Samples of history kept per agent (one per
+     *        STATUS reply or TELEMETRY frame, so 600 is 10 min at 1 s);
+     *        0 disables history.
+     */
+    explicit StatsRepo(size_t historySamples = 600);
+
+    /// Replaces the agent's latest stats and appends them to its history.
+    void upsert(Stats s);
     void removeByConnId(int id);
-    std::vector<Stats> snapshot() const;
-    std::optional<Stats> get(int id) const;
+    /// Latest stats of every agent, by conn_id.
+    std::vector<StatsPtr> snapshot() const;
+    /// Latest stats of @p id, or null.
+    StatsPtr get(int id) const;
+
+    /**
+     * @brief Aggregates one metric of an agent over a time range, see
+     * MetricHistory::query().
+     * @return false if the agent or the series is unknown.
+     */
+    bool history(int conn_id, std::string_view series, MetricHistory::clock::time_point from,
+                 MetricHistory::clock::time_point to, std::chrono::milliseconds step,
+                 std::vector<MetricHistory::Point>& out) const;
+
+    /// Series recorded for an agent, empty if it is unknown.
+    std::vector<std::string> historySeries(int conn_id) const;
 
 private:
-    mutable std::mutex mx_;
-    std::vector<Stats> data_;
+    struct Slot {
+        explicit Slot(size_t historySamples) : history(historySamples ? historySamples : 1) {}
+
+        StatsPtr stats;                // std::atomic_load/store
+        mutable std::mutex historyMx;  // the agent's own; see upsert()
+        MetricHistory history;
+    };
+    using SlotPtr = std::shared_ptr<Slot>;
+
+    using Index = std::unordered_map<int, SlotPtr>;
+    using IndexPtr = std::shared_ptr<const Index>;
+
+    struct Shard {
+        std::mutex mx;  // serialises copies of index (agents added or removed)
+        IndexPtr index = std::make_shared<const Index>();  // std::atomic_load/store
+    };
+    static constexpr size_t kShards = 64;
+
+    Shard& shardOf(int id) const { return shards_[static_cast<unsigned>(id) % kShards]; }
+    // Slot of @p id in the published index, or null
+    SlotPtr find(int id) const;
+
+    const size_t historySamples_;
+    mutable std::array<Shard, kShards> shards_;
 };
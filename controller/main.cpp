@@ -22,7 +22,9 @@ int main() {
     // Initialize repositories and registry
     StatsRepo statsRepo;
     CmdRepo cmdRepo;
-    CommandRegistry registry(statsRepo, cmdRepo, TOKEN);
+    ReplyRepo<ProcInfo> topRepo;
+    ReplyRepo<JobInfo> jobRepo;
+    CommandRegistry registry(statsRepo, cmdRepo, topRepo, jobRepo, TOKEN);
     Server server(registry);
 
     // Start the server and check for errors
@@ -40,7 +42,7 @@ int main() {
     std::cout << "[controller] running; press Ctrl-C to stop\n";
 
     // Start the command-line interface (CLI) for user interaction
-    Console cli(server, statsRepo, cmdRepo);
+    Console cli(server, statsRepo, cmdRepo, topRepo, jobRepo);
     int rc = cli.repl();
 
     // Stop the scheduler and server during shutdown
@@ -5,11 +5,13 @@
 #include <cctype>
 #include <chrono>
 #include <csignal>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 #include "../../core/include/utils.h"
 #include "../include/cli_utils.h"
@@ -31,46 +33,92 @@ void Console::installSignalsOnce() {
     });
 }
 
-Console::Console(Server& server, StatsRepo& statsRepo, CmdRepo& cmdRepo)
-    : server_(server), statsRepo_(statsRepo), cmdRepo_(cmdRepo) {
+Console::Console(Server& server, StatsRepo& statsRepo, CmdRepo& cmdRepo,
+                 ReplyRepo<ProcInfo>& topRepo, ReplyRepo<JobInfo>& jobRepo)
+    : server_(server),
+      statsRepo_(statsRepo),
+      cmdRepo_(cmdRepo),
+      topRepo_(topRepo),
+      jobRepo_(jobRepo) {
     installSignalsOnce();  // Install signal handlers during initialization
 }
 
+namespace {
+std::string fixed(double v, int precision) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(precision) << v;
+    return os.str();
+}
+
+// Value of one metric with its unit: "12.5%", "1.2GiB", "3.4MiB/s", "120/s"
+std::string formatMetric(const MetricSet& m, const MetricSet::Entry& e) {
+    switch (metric::kindOf(e.id)) {
+        case metric::CPU:
+        case metric::CORE_CPU:
+        case metric::CPU_MIN:
+        case metric::CPU_MAX:
+        case metric::CPU_P95:
+            return fixed(m.real(e.id), 1) + "%";
+        case metric::LOAD1:
+        case metric::LOAD5:
+        case metric::LOAD15:
+            return fixed(m.real(e.id), 2);
+        case metric::MEM_USED:
+        case metric::MEM_TOTAL:
+        case metric::DISK_USED:
+        case metric::DISK_TOTAL:
+        case metric::FS_USED:
+        case metric::FS_TOTAL:
+            return humanBytes(e.value * 1024);
+        case metric::NET_RX_BYTES:
+        case metric::NET_TX_BYTES:
+        case metric::BLK_READ_BYTES:
+        case metric::BLK_WRITE_BYTES:
+            return humanBytes(e.value) + "/s";
+        case metric::NET_RX_PACKETS:
+        case metric::NET_TX_PACKETS:
+        case metric::BLK_READ_OPS:
+        case metric::BLK_WRITE_OPS:
+            return std::to_string(e.value) + "/s";
+        default:
+            return std::to_string(e.value);
+    }
+}
+}  // namespace
+
 void Console::printStatus() {
+    using metric::makeId;
     print_table(
-        {"ID", "CPU%", "MEM (used/total)", "MEM%", "DISK (used/total)",
-         "DSK%"},  // Table headers
+        {"ID", "CPU%", "PEAK", "LOAD", "MEM (used/total)", "MEM%", "DISK (used/total)",
+         "DSK%", "NET rx/tx", "IO r/w"},  // Table headers
         [&]() {
             std::vector<std::vector<std::string>> out;
             auto rows =
                 statsRepo_.snapshot();  // Get a snapshot of current stats
             for (const auto& s : rows) {
-                const auto memp = pct(
-                    s.mem_used_bytes,
-                    s.mem_total_bytes);  // Calculate memory usage percentage
-                const auto dskp =
-                    pct(s.disk_used_bytes,
-                        s.disk_total_bytes);  // Calculate disk usage percentage
-
-                std::ostringstream mem, dsk;
-                mem << humanBytes(s.mem_used_bytes) << "/"
-                    << humanBytes(s.mem_total_bytes);  // Format memory usage
-                dsk << humanBytes(s.disk_used_bytes) << "/"
-                    << humanBytes(s.disk_total_bytes);  // Format disk usage
+                const MetricSet& m = s->metrics;
+                // memory and disk are reported in KiB
+                const uint64_t memUsed = m.value(makeId(metric::MEM_USED)) * 1024;
+                const uint64_t memTotal = m.value(makeId(metric::MEM_TOTAL)) * 1024;
+                const uint64_t dskUsed = m.value(makeId(metric::DISK_USED)) * 1024;
+                const uint64_t dskTotal = m.value(makeId(metric::DISK_TOTAL)) * 1024;
+
+                // I/O rates summed over every NIC / block device
+                auto rate = [&](metric::Kind a, metric::Kind b) {
+                    return humanBytes(m.sum(a)) + "/" + humanBytes(m.sum(b)) + "/s";
+                };
 
                 out.push_back(
-                    {std::to_string(s.conn_id),
-                     (std::ostringstream()
-                      << std::fixed << std::setprecision(1) << s.cpu_percent)
-                         .str(),  // Format CPU usage
-                     mem.str(),
-                     (std::ostringstream()
-                      << std::fixed << std::setprecision(0) << memp)
-                         .str(),  // Format memory percentage
-                     dsk.str(),
-                     (std::ostringstream()
-                      << std::fixed << std::setprecision(0) << dskp)
-                         .str()});  // Format disk percentage
+                    {std::to_string(s->conn_id),
+                     fixed(m.real(makeId(metric::CPU)), 1),  // Format CPU usage
+                     fixed(m.real(makeId(metric::CPU_MAX)), 1),  // Highest reading in the interval
+                     fixed(m.real(makeId(metric::LOAD1)), 2),
+                     humanBytes(memUsed) + "/" + humanBytes(memTotal),
+                     fixed(pct(memUsed, memTotal), 0),  // Format memory percentage
+                     humanBytes(dskUsed) + "/" + humanBytes(dskTotal),
+                     fixed(pct(dskUsed, dskTotal), 0),  // Format disk percentage
+                     rate(metric::NET_RX_BYTES, metric::NET_TX_BYTES),
+                     rate(metric::BLK_READ_BYTES, metric::BLK_WRITE_BYTES)});
             }
             return out;
         }(),
@@ -79,14 +127,35 @@ void Console::printStatus() {
     );
 }
 
+void Console::printStatusDetail(int conn_id) {
+    auto s = statsRepo_.get(conn_id);
+    if (!s) {
+        std::cout << "status: no stats for conn_id " << conn_id << "\n";
+        return;
+    }
+    std::cout << std::left << std::setw(28) << "Metric" << std::right
+              << std::setw(14) << "Value" << "\n";
+    for (const auto& e : s->metrics.entries())
+        std::cout << std::left << std::setw(28) << s->metrics.nameOf(e.id)
+                  << std::right << std::setw(14)
+                  << formatMetric(s->metrics, e) << "\n";
+    std::cout << std::flush;
+}
+
 void Console::runStatus(bool watch, int interval_ms) {
     g_stop.store(false);  // Reset the stop flag
 
     auto tick = [&] {
-        server_.broadcast(std::string(specula::CMD_STATUS),
-                          "");  // Request status from all agents
-        sleepFor(std::chrono::milliseconds(150));  // Wait for responses
-        printStatus();                             // Print the status table
+        // v2 agents are subscribed and push their stats; only poll v1 ones
+        bool polled = false;
+        server_.forEachConn([&](Connection& c) {
+            if (c.protocol() >= specula::PROTO_BINARY) return;
+            c.send(specula::CMD_STATUS, "");
+            polled = true;
+        });
+        if (polled)
+            sleepFor(std::chrono::milliseconds(150));  // Wait for responses
+        printStatus();                                 // Print the status table
     };
 
     if (!watch) {
@@ -114,42 +183,71 @@ void Console::sleepFor(std::chrono::milliseconds ms) {
 
 void Console::runExec(bool all, int conn_id, std::string& cmd) {
     const bool monitor = !all;  // Monitor output only for specific connections
+    // The agent kills the command after this long; Ctrl-C kills it sooner
+    const auto exec_timeout =
+        std::chrono::milliseconds(specula::EXEC_DEFAULT_TIMEOUT_MS);
+    const std::string timeout_opt = " " + std::string(specula::EXEC_TIMEOUT_KEY) +
+                                    "=" + std::to_string(exec_timeout.count());
+    g_stop.store(false);
 
     auto wait_done_print = [&](int id, const std::string& prefix, bool follow) {
         using clk = std::chrono::steady_clock;
         auto start = clk::now();
-        const auto timeout =
-            std::chrono::seconds(60);  // Timeout for command execution
-        std::string last_tail;
+        // the agent's own timeout plus its SIGTERM grace and some slack
+        auto timeout = exec_timeout + std::chrono::seconds(5);
+        bool killed = false;
+        size_t out_off = 0;  // stream offset printed up to
+        std::string out;
 
         while (true) {
             auto rec = cmdRepo_.get(id);  // Get the command record
+            if (rec && !killed && g_stop.load()) {
+                // Ctrl-C: kill it on the agent, then wait for its EXEC_DONE
+                std::cout << "[" << prefix << " id=" << id << "] interrupted, killing\n";
+                killed = sendKill(rec->conn_id, id);
+                start = clk::now();
+                timeout = std::chrono::seconds(5);
+            }
             if (rec) {
-                if (follow && rec->monitor) {
-                    if (rec->tail != last_tail) {
-                        // Print new output from the command
+                if (follow && rec->monitor && rec->out_end > out_off) {
+                    // Print only the output that arrived since the last poll
+                    if (out_off == 0)
                         std::cout << "---- [" << prefix << " id=" << id
                                   << " stream] ----\n";
-                        std::cout << rec->tail << std::flush;
-                        last_tail = rec->tail;
+                    out.clear();
+                    if (auto next = cmdRepo_.readOut(id, out_off, out)) {
+                        const size_t from = *next - out.size();
+                        if (from > out_off)
+                            std::cout << "[... " << (from - out_off)
+                                      << " bytes dropped]\n";
+                        std::cout << out << std::flush;
+                        out_off = *next;
                     }
                 }
                 if (rec->state == CmdRecord::State::Done) {
                     // Command execution completed
                     std::cout << "---- [" << prefix << " id=" << id << " done] "
-                              << "exit_code=" << rec->exit_code
-                              << " (bytes_out=" << rec->bytes_out
+                              << "exit_code=" << rec->exit_code;
+                    if (rec->exit_signal)
+                        std::cout << " signal=" << rec->exit_signal;
+                    if (!rec->end_reason.empty())
+                        std::cout << " " << rec->end_reason;
+                    std::cout << " (bytes_out=" << rec->bytes_out
+                              << ", stderr=" << rec->bytes_err
                               << ", chunks=" << rec->chunks_out << ")\n";
-                    if (!follow && !rec->tail.empty()) {
-                        std::cout << rec->tail << std::flush;
+                    out.clear();
+                    if (!follow && cmdRepo_.readOut(id, 0, out) && !out.empty()) {
+                        std::cout << out << std::flush;
                     }
                     return;
                 }
             }
             if (clk::now() - start > timeout) {
-                // Timeout waiting for the result
+                // Timeout waiting for the result: make sure it does not keep
+                // running unseen
                 std::cout << "[" << prefix << " id=" << id
                           << "] timeout waiting result\n";
+                if (rec && !killed) sendKill(rec->conn_id, id);
                 return;
             }
             std::this_thread::sleep_for(
@@ -163,15 +261,15 @@ void Console::runExec(bool all, int conn_id, std::string& cmd) {
             if (!c.isRunning()) return;        // Skip inactive connections
             const int id = cmdRepo_.nextId();  // Generate a new command ID
             cmdRepo_.add(
-                id, c.getCfd(), cmd,
+                id, c.getId(), cmd,
                 /*monitor=*/false);  // Add the command to the repository
-            launched.push_back(std::make_pair(id, c.getCfd()));
+            launched.push_back(std::make_pair(id, c.getId()));
         });
 
         for (auto& l : launched) {
             if (server_.send("EXEC",
-                             "id=" + std::to_string(l.first) + " monitor=0\n" +
-                                 cmd + "\n",
+                             "id=" + std::to_string(l.first) + " monitor=0" +
+                                 timeout_opt + "\n" + cmd + "\n",
                              l.second)) {
                 cmdRepo_.start(l.first);  // Mark the command as started
             } else {
@@ -198,7 +296,9 @@ void Console::runExec(bool all, int conn_id, std::string& cmd) {
                 continue;
             }
             std::cout << "  id=" << id.first << " conn=" << r->conn_id
-                      << " code=" << r->exit_code << " out=" << r->bytes_out
+                      << " code=" << r->exit_code;
+            if (r->exit_signal) std::cout << " signal=" << r->exit_signal;
+            std::cout << " out=" << r->bytes_out
                       << "B"
                       << " chunks=" << r->chunks_out << "\n";
         }
@@ -210,11 +310,13 @@ void Console::runExec(bool all, int conn_id, std::string& cmd) {
         return;
     }
     const int id = cmdRepo_.nextId();
+    const size_t window = specula::EXEC_WINDOW_BYTES;  // EXEC_OUT credit
     cmdRepo_.add(id, conn_id, cmd,
-                 /*monitor=*/true);  // Add the command to the repository
+                 /*monitor=*/true, window);  // Add the command to the repository
     if (!server_.send("EXEC",
                       "id=" + std::to_string(id) + " monitor=" +
-                          (monitor ? "1" : "0") + "\n" + cmd + "\n",
+                          (monitor ? "1" : "0") + " window=" +
+                          std::to_string(window) + timeout_opt + "\n" + cmd + "\n",
                       conn_id)) {
         std::cout << "[exec] failed to send to conn_id=" << conn_id << "\n";
         cmdRepo_.erase(id);  // Remove the command if sending failed
@@ -226,6 +328,182 @@ void Console::runExec(bool all, int conn_id, std::string& cmd) {
     wait_done_print(id, "exec", /*follow=*/true);
 }
 
+void Console::runMetrics(int conn_id) {
+    auto quantiles = [](const HistogramSnapshot& h) {
+        if (h.total() == 0) return std::string("-");
+        return humanDuration(h.quantileNs(0.5)) + "/" +
+               humanDuration(h.quantileNs(0.99));
+    };
+    auto row = [&](const std::string& id, const TransportSnapshot& m) {
+        return std::vector<std::string>{
+            id,
+            humanBytes(m.bytesIn) + "/" + humanBytes(m.bytesOut),
+            std::to_string(m.framesIn) + "/" + std::to_string(m.framesOut),
+            std::to_string(m.queuedFrames) + " (" + humanBytes(m.queuedBytes) +
+                ")",
+            quantiles(m.handlerNs),
+            quantiles(m.dispatchNs)};
+    };
+    const std::vector<std::string> headers = {
+        "ID", "Bytes in/out", "Frames in/out", "Queued",
+        "Handler p50/p99", "Rx->dispatch p50/p99"};
+
+    std::vector<std::pair<int, TransportSnapshot>> conns;
+    server_.forEachConn([&](Connection& c) {
+        if (conn_id <= 0 || c.getId() == conn_id)
+            conns.emplace_back(c.getId(), c.metrics());
+    });
+    std::sort(conns.begin(), conns.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    if (conn_id <= 0) {
+        if (conns.empty()) {
+            std::cout << "no active connections\n";
+            return;
+        }
+        std::vector<std::vector<std::string>> rows;
+        TransportSnapshot total;
+        for (const auto& [id, m] : conns) {
+            rows.push_back(row(std::to_string(id), m));
+            total.merge(m);
+        }
+        rows.push_back(row("all", total));
+        print_table(headers, rows, "Transport metrics", 0);
+        return;
+    }
+
+    if (conns.empty()) {
+        std::cout << "metrics: unknown conn_id " << conn_id << "\n";
+        return;
+    }
+    const TransportSnapshot& m = conns.front().second;
+    print_table(headers, {row(std::to_string(conn_id), m)},
+                "Transport metrics", 0);
+
+    // print_table() redraws from the top of the screen, so the details
+    // below it are plain text
+    std::cout << "\n" << std::left << std::setw(12) << "Command"
+              << std::right << std::setw(12) << "Frames in" << std::setw(12)
+              << "Frames out" << "\n";
+    for (size_t op = 0; op < m.cmdIn.size(); ++op) {
+        if (!m.cmdIn[op] && !m.cmdOut[op]) continue;
+        const std::string_view name = specula::commandOf(
+            static_cast<uint16_t>(op));
+        std::cout << std::left << std::setw(12)
+                  << (name.empty() ? "(other)" : std::string(name))
+                  << std::right << std::setw(12) << m.cmdIn[op]
+                  << std::setw(12) << m.cmdOut[op] << "\n";
+    }
+
+    std::cout << "\n" << std::left << std::setw(12) << "Bucket"
+              << std::right << std::setw(12) << "Handler" << std::setw(14)
+              << "Rx->dispatch" << "\n";
+    for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i) {
+        if (!m.handlerNs.counts[i] && !m.dispatchNs.counts[i]) continue;
+        std::cout << std::left << std::setw(12)
+                  << (">= " + humanDuration(HistogramSnapshot::bucketFloorNs(i)))
+                  << std::right << std::setw(12) << m.handlerNs.counts[i]
+                  << std::setw(14) << m.dispatchNs.counts[i] << "\n";
+    }
+    std::cout << std::flush;
+}
+
+void Console::runTop(int conn_id, int n, bool byMem) {
+    const uint64_t seen = topRepo_.version(conn_id);
+    std::ostringstream req;
+    req << specula::TOP_COUNT_KEY << "=" << n << " " << specula::TOP_BY_KEY
+        << "=" << (byMem ? "mem" : "cpu") << "\n";
+    if (!server_.send(std::string(specula::CMD_TOP), req.str(), conn_id)) {
+        std::cout << "top: unknown conn_id " << conn_id << "\n";
+        return;
+    }
+
+    // The agent's first scan waits a moment for a CPU baseline
+    auto procs = topRepo_.waitNewer(conn_id, seen, std::chrono::seconds(3));
+    if (!procs) {
+        std::cout << "top: no reply from conn_id " << conn_id << "\n";
+        return;
+    }
+    std::cout << std::right << std::setw(8) << "PID" << std::setw(8) << "CPU%"
+              << std::setw(12) << "RSS" << "  " << "COMMAND" << "\n";
+    for (const auto& p : *procs)
+        std::cout << std::right << std::setw(8) << p.pid << std::setw(8)
+                  << fixed(p.cpu_centi / 100.0, 1) << std::setw(12)
+                  << humanBytes(p.rss_kb * 1024) << "  " << p.name << "\n";
+    std::cout << std::flush;
+}
+
+bool Console::sendKill(int conn_id, int id) {
+    return server_.send(std::string(specula::CMD_EXEC_KILL),
+                        "id=" + std::to_string(id) + "\n", conn_id);
+}
+
+void Console::runJobs(int conn_id) {
+    const uint64_t seen = jobRepo_.version(conn_id);
+    if (!server_.send(std::string(specula::CMD_EXEC_LIST), "", conn_id)) {
+        std::cout << "jobs: unknown conn_id " << conn_id << "\n";
+        return;
+    }
+    auto jobs = jobRepo_.waitNewer(conn_id, seen, std::chrono::seconds(3));
+    if (!jobs) {
+        std::cout << "jobs: no reply from conn_id " << conn_id << "\n";
+        return;
+    }
+    if (jobs->empty()) {
+        std::cout << "no jobs\n";
+        return;
+    }
+    std::vector<std::vector<std::string>> rows;
+    rows.reserve(jobs->size());
+    for (const auto& j : *jobs)
+        rows.push_back({std::to_string(j.id), j.running ? "running" : "queued",
+                        j.running ? std::to_string(j.pid) : "-",
+                        fixed(j.age_ms / 1000.0, 1) + "s",
+                        humanBytes(j.bytes_out), j.cmd});
+    print_table({"ID", "State", "PID", "Age", "Output", "Command"}, rows,
+                "Jobs on conn " + std::to_string(conn_id), 0);
+}
+
+void Console::runHistory(int conn_id, const std::string& series, int seconds,
+                         int step_s) {
+    if (series.empty()) {
+        auto names = statsRepo_.historySeries(conn_id);
+        if (names.empty()) {
+            std::cout << "history: nothing recorded for conn_id " << conn_id
+                      << "\n";
+            return;
+        }
+        for (const auto& n : names) std::cout << n << "\n";
+        std::cout << std::flush;
+        return;
+    }
+
+    const auto now = MetricHistory::clock::now();
+    const auto from = now - std::chrono::seconds(seconds);
+    std::vector<MetricHistory::Point> points;
+    if (!statsRepo_.history(conn_id, series, from, now,
+                            std::chrono::seconds(step_s), points)) {
+        std::cout << "history: no series '" << series << "' for conn_id "
+                  << conn_id << "\n";
+        return;
+    }
+    if (points.empty()) {
+        std::cout << "no samples in the last " << seconds << "s\n";
+        return;
+    }
+    std::vector<std::vector<std::string>> rows;
+    rows.reserve(points.size());
+    for (const auto& p : points) {
+        const auto ago =
+            std::chrono::duration_cast<std::chrono::seconds>(now - p.t).count();
+        rows.push_back({"-" + std::to_string(ago) + "s", fixed(p.min, 2),
+                        fixed(p.mean, 2), fixed(p.max, 2),
+                        std::to_string(p.count)});
+    }
+    print_table({"Since", "Min", "Mean", "Max", "Samples"}, rows,
+                series + " on conn " + std::to_string(conn_id), 0);
+}
+
 int Console::repl() {
     std::cout << "Specula CLI — type 'help' for commands.\n";
     std::string line;
@@ -263,10 +541,23 @@ int Console::repl() {
                    "current status from all agents\n"
                    "  status -w [ms]                   - watch mode; "
                    "refresh every [ms] (default 1500)\n"
+                   "  status <conn_id>                 - every metric of "
+                   "one agent (per core, NIC, disk)\n"
+                   "  top <conn_id> [n] [cpu|mem]      - busiest processes "
+                   "of an agent (default 10 by cpu)\n"
+                   "  history <conn_id> [metric] [s] [step]\n"
+                   "                                   - metric over the last "
+                   "[s] seconds (default 60, step 5)\n"
                    "  exec <conn_id|all> <command...>  - execute command "
-                   "on agent(s)\n"
+                   "on agent(s); Ctrl-C kills it\n"
+                   "  jobs <conn_id>                   - running and queued "
+                   "exec jobs of an agent\n"
+                   "  kill <conn_id> <id>              - kill an exec job "
+                   "(or drop it from the queue)\n"
                    "  ls                               - list active "
                    "connections\n"
+                   "  metrics [conn_id]                - transport metrics, "
+                   "per connection and aggregate\n"
                    "  clear                            - clear the screen\n"
                    "  quit | exit                      - leave the CLI\n";
             continue;
@@ -297,17 +588,105 @@ int Console::repl() {
                     return ss.str();
                 };
 
+                // compression achieved on what each agent sent us, and how
+                // long our control frames waited in the send queue
+                std::unordered_map<int, std::pair<std::string, std::string>>
+                    info;
+                server_.forEachConn([&](Connection& c) {
+                    auto& [comp, ctl] = info[c.getId()];
+                    std::ostringstream cs, ls;
+                    if (c.compression()) {
+                        const auto st = c.compressionStats();
+                        cs << std::fixed << std::setprecision(2)
+                           << st.ratioIn() << "x (" << humanBytes(st.rawIn)
+                           << " -> " << humanBytes(st.wireIn) << ")";
+                    } else {
+                        cs << "off";
+                    }
+                    const auto lat = c.controlLatency();
+                    ls << std::fixed << std::setprecision(0) << lat.avgUs()
+                       << "/" << lat.maxUs << "us";
+                    comp = cs.str();
+                    ctl = ls.str();
+                });
+
                 std::vector<std::vector<std::string>> rows;
                 rows.reserve(eps.size());
                 for (const auto& [id, ep] : eps) {
+                    auto it = info.find(id);
+                    const bool known = it != info.end();
                     rows.push_back({std::to_string(id),
                                     fmt_addr(ep.peer_ip, ep.peer_port),
-                                    fmt_addr(ep.local_ip, ep.local_port)});
+                                    fmt_addr(ep.local_ip, ep.local_port),
+                                    known ? it->second.first : "-",
+                                    known ? it->second.second : "-"});
                 }
 
-                print_table({"ID", "Peer", "Local"}, rows, "Active connections",
-                            0);
+                print_table({"ID", "Peer", "Local", "Compression",
+                             "Ctl delay avg/max"},
+                            rows, "Active connections", 0);
+            }
+            continue;
+        }
+
+        if (cmd == "metrics") {
+            int conn_id = 0;
+            iss >> conn_id;
+            runMetrics(conn_id);
+            continue;
+        }
+
+        if (cmd == "top") {
+            int conn_id = 0;
+            if (!(iss >> conn_id) || conn_id <= 0) {
+                std::cout << "usage: top <conn_id> [n] [cpu|mem]\n";
+                continue;
+            }
+            int n = static_cast<int>(specula::TOP_DEFAULT_COUNT);
+            bool byMem = false;
+            std::string arg;
+            while (iss >> arg) {
+                if (arg == "mem")
+                    byMem = true;
+                else if (arg != "cpu" && std::isdigit(static_cast<unsigned char>(arg[0])))
+                    n = std::max(1, std::atoi(arg.c_str()));
+            }
+            runTop(conn_id, n, byMem);
+            continue;
+        }
+
+        if (cmd == "history") {
+            int conn_id = 0;
+            if (!(iss >> conn_id) || conn_id <= 0) {
+                std::cout << "usage: history <conn_id> [metric] [seconds] "
+                             "[step_s]\n";
+                continue;
+            }
+            std::string series;  // none: list the series
+            int seconds = 60, step_s = 5;
+            iss >> series >> seconds >> step_s;
+            runHistory(conn_id, series, std::max(1, seconds), std::max(1, step_s));
+            continue;
+        }
+
+        if (cmd == "jobs") {
+            int conn_id = 0;
+            if (!(iss >> conn_id) || conn_id <= 0) {
+                std::cout << "usage: jobs <conn_id>\n";
+                continue;
+            }
+            runJobs(conn_id);
+            continue;
+        }
+
+        if (cmd == "kill") {
+            int conn_id = 0, id = 0;
+            if (!(iss >> conn_id >> id) || conn_id <= 0 || id <= 0) {
+                std::cout << "usage: kill <conn_id> <id>\n";
+                continue;
             }
+            if (!sendKill(conn_id, id))
+                std::cout << "kill: unknown conn_id " << conn_id << "\n";
             continue;
         }
 
@@ -363,6 +742,8 @@ int Console::repl() {
                     if (interval_ms < 100) interval_ms = 100;
                 }
                 runStatus(true, interval_ms);
+            } else if (!opt.empty() && std::isdigit(static_cast<unsigned char>(opt[0]))) {
+                printStatusDetail(std::atoi(opt.c_str()));
             } else {
                 runStatus(false, 0);
             }
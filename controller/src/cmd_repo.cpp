@@ -15,7 +15,8 @@ int CmdRepo::makeId_() {
 int CmdRepo::nextId() { return makeId_(); }
 
 // Adds a new command record or updates an existing one
-int CmdRepo::add(int id, int conn_id, std::string cmd, bool monitor) {
+int CmdRepo::add(int id, int conn_id, std::string cmd, bool monitor,
+                 size_t credit_window) {
     const auto now = clock::now();
     if (id <= 0) id = makeId_(); // Generate ID if not provided
 
@@ -24,13 +25,14 @@ int CmdRepo::add(int id, int conn_id, std::string cmd, bool monitor) {
     rec.conn_id = conn_id;
     rec.cmd = std::move(cmd);
     rec.monitor = monitor;
+    rec.credit_window = credit_window;
     rec.state = CmdRecord::State::Pending;
     rec.t_created = now;
     rec.t_last_update = now;
 
     std::lock_guard<std::mutex> lk(mx_);
     by_id_.erase(id); // Remove existing record with the same ID, if any
-    by_id_.emplace(id, std::move(rec)); // Insert the new or updated record
+    by_id_.emplace(id, Entry{std::move(rec), OutputRing(tail_limit_)}); // Insert the new or updated record
     return id;
 }
 
@@ -41,7 +43,7 @@ bool CmdRepo::start(int id) {
     auto it = by_id_.find(id);
     if (it == by_id_.end()) return false; // ID not found
 
-    auto& r = it->second;
+    auto& r = it->second.rec;
     r.state = CmdRecord::State::Running;
     r.t_started = now;
     r.t_last_update = now;
@@ -49,33 +51,52 @@ bool CmdRepo::start(int id) {
 }
 
 // Appends output data to a command record
-bool CmdRepo::appendOut(int id, const std::string& chunk) {
+bool CmdRepo::appendOut(int id, std::string_view chunk, bool err) {
     const auto now = clock::now();
     std::lock_guard<std::mutex> lk(mx_);
     auto it = by_id_.find(id);
     if (it == by_id_.end()) return false; // ID not found
 
-    auto& r = it->second;
+    auto& r = it->second.rec;
     r.bytes_out += chunk.size();
     r.chunks_out += 1;
+    if (err) r.bytes_err += chunk.size();
+    if (r.credit_window) r.credit_unacked += chunk.size();
     if (r.monitor) {
+        auto& out = it->second.out;
         r.state = CmdRecord::State::Streaming;
-        r.tail.append(chunk); // Append chunk to tail
-        trimTail_(r); // Trim tail if it exceeds the limit
+        out.append(chunk); // Append chunk to the output, dropping the oldest blocks
+        r.out_begin = out.begin();
+        r.out_end = out.end();
     }
     r.t_last_update = now;
     return true;
 }
 
+// Returns the credit due for a flow-controlled stream, in half-window batches
+size_t CmdRepo::takeCredit(int id) {
+    std::lock_guard<std::mutex> lk(mx_);
+    auto it = by_id_.find(id);
+    if (it == by_id_.end()) return 0; // ID not found
+
+    auto& r = it->second.rec;
+    if (!r.credit_window || r.credit_unacked < r.credit_window / 2) return 0;
+    const size_t n = r.credit_unacked;
+    r.credit_unacked = 0;
+    return n;
+}
+
 // Marks a command as done and records the exit code
-bool CmdRepo::done(int id, int exit_code) {
+bool CmdRepo::done(int id, int exit_code, int exit_signal, std::string_view reason) {
     const auto now = clock::now();
     std::lock_guard<std::mutex> lk(mx_);
     auto it = by_id_.find(id);
     if (it == by_id_.end()) return false; // ID not found
 
-    auto& r = it->second;
+    auto& r = it->second.rec;
     r.exit_code = exit_code;
+    r.exit_signal = exit_signal;
+    r.end_reason.assign(reason);
     r.state = CmdRecord::State::Done;
     r.t_finished = now;
     r.t_last_update = now;
@@ -87,7 +108,16 @@ std::optional<CmdRecord> CmdRepo::get(int id) const {
     std::lock_guard<std::mutex> lk(mx_);
     auto it = by_id_.find(id);
     if (it == by_id_.end()) return std::nullopt; // ID not found
-    return it->second;
+    return it->second.rec;
+}
+
+// Copies the retained output of a command from an offset on
+std::optional<size_t> CmdRepo::readOut(int id, size_t offset, std::string& out,
+                                       size_t max_bytes) const {
+    std::lock_guard<std::mutex> lk(mx_);
+    auto it = by_id_.find(id);
+    if (it == by_id_.end()) return std::nullopt; // ID not found
+    return it->second.out.read(offset, out, max_bytes);
 }
 
 // Returns a snapshot of all command records
@@ -95,7 +125,7 @@ std::vector<CmdRecord> CmdRepo::snapshot() const {
     std::vector<CmdRecord> out;
     std::lock_guard<std::mutex> lk(mx_);
     out.reserve(by_id_.size());
-    for (const auto& kv : by_id_) out.push_back(kv.second);
+    for (const auto& kv : by_id_) out.push_back(kv.second.rec);
     return out;
 }
 
@@ -114,12 +144,30 @@ size_t CmdRepo::removeByConn(int conn_id) {
     std::lock_guard<std::mutex> lk(mx_);
     size_t before = by_id_.size();
     for (auto it = by_id_.begin(); it != by_id_.end(); ) {
-        if (it->second.conn_id == conn_id) it = by_id_.erase(it); // Erase record and get next iterator
+        if (it->second.rec.conn_id == conn_id) it = by_id_.erase(it); // Erase record and get next iterator
         else ++it;
     }
     return before - by_id_.size(); // Return the number of removed records
 }
 
+// Marks the unfinished command records of a connection as done
+size_t CmdRepo::finishByConn(int conn_id, std::string_view reason) {
+    const auto now = clock::now();
+    std::lock_guard<std::mutex> lk(mx_);
+    size_t finished = 0;
+    for (auto& kv : by_id_) {
+        auto& r = kv.second.rec;
+        if (r.conn_id != conn_id || r.state == CmdRecord::State::Done) continue;
+        r.exit_code = -1;
+        r.end_reason.assign(reason);
+        r.state = CmdRecord::State::Done;
+        r.t_finished = now;
+        r.t_last_update = now;
+        ++finished;
+    }
+    return finished; // Return the number of finished records
+}
+
 // Erases a command record by ID
 bool CmdRepo::erase(int id) {
     std::lock_guard<std::mutex> lk(mx_);
@@ -132,7 +180,7 @@ size_t CmdRepo::clearDoneOlderThan(std::chrono::seconds age) {
     std::lock_guard<std::mutex> lk(mx_);
     size_t removed = 0;
     for (auto it = by_id_.begin(); it != by_id_.end(); ) {
-        const auto& r = it->second;
+        const auto& r = it->second.rec;
         // Check if the record is done, has a valid finish time, and is older than the specified age
         if (r.state == CmdRecord::State::Done &&
             r.t_finished != CmdRecord{}.t_finished &&
@@ -146,16 +194,12 @@ size_t CmdRepo::clearDoneOlderThan(std::chrono::seconds age) {
     return removed; // Return the number of removed records
 }
 
-// Sets the limit for the tail size and trims existing tails if necessary
+// Sets the limit for the retained output and trims existing buffers if necessary
 void CmdRepo::setTailLimit(size_t bytes) {
     std::lock_guard<std::mutex> lk(mx_);
     tail_limit_ = bytes;
-    for (auto& kv : by_id_) trimTail_(kv.second); // Trim tail of each record
-}
-
-// Trims the tail of a command record to fit the size limit
-void CmdRepo::trimTail_(CmdRecord& r) {
-    if (tail_limit_ == 0) { r.tail.clear(); return; } // Clear tail if limit is 0
-    if (r.tail.size() <= tail_limit_) return; // No trimming needed
-    r.tail.erase(0, r.tail.size() - tail_limit_); // Trim the tail
+    for (auto& kv : by_id_) {
+        kv.second.out.setLimit(bytes); // Drop output beyond the new limit
+        kv.second.rec.out_begin = kv.second.out.begin();
+    }
 }
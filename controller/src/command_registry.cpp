@@ -1,126 +1,226 @@
 #include "../include/command_registry.h"
 
+#include "../../core/include/status_codec.h"
+#include "../../core/include/job_codec.h"
+#include "../../core/include/top_codec.h"
 #include "../../core/include/utils.h"
 
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
 
-CommandRegistry::CommandRegistry(StatsRepo& statsRepo, CmdRepo& cmdRepo, const std::string& token)
-    : statsRepo_(statsRepo), cmdRepo_(cmdRepo), token_(token) {} // Initialize CommandRegistry with references to repositories and token
+CommandRegistry::CommandRegistry(StatsRepo& statsRepo, CmdRepo& cmdRepo,
+                                 ReplyRepo<ProcInfo>& topRepo, ReplyRepo<JobInfo>& jobRepo,
+                                 const std::string& token)
+    : statsRepo_(statsRepo),
+      cmdRepo_(cmdRepo),
+      topRepo_(topRepo),
+      jobRepo_(jobRepo),
+      token_(token) {
+    // Build the handler table once; every connection shares it read-only
+    auto t = std::make_shared<DispatchTable>();
+    registerAuth_(*t);
+    registerPing_(*t);
+    registerPong_(*t);
+    registerExecOut_(*t);
+    registerExecDone_(*t);
+    registerStatus_(*t);
+    registerTelemetry_(*t);
+    registerTop_(*t);
+    registerExecList_(*t);
+    registerErr_(*t);
+    registerBye_(*t);
+    registerDefault_(*t);
+    table_ = std::move(t);
+}
 
 void CommandRegistry::attach(Connection& c) {
-    // Attach all command handlers to the connection
-    registerAuth_(c);
-    registerPing_(c);
-    registerPong_(c);
-    registerExecOut_(c);
-    registerExecDone_(c);
-    registerStatus_(c);
-    registerBye_(c);
-    registerDefault_(c);
-}
-
-void CommandRegistry::registerAuth_(Connection& c) {
+    c.setDispatchTable(table_); // Route the connection's frames through the shared table
+}
+
+void CommandRegistry::detach(int conn_id) {
+    statsRepo_.removeByConnId(conn_id);
+    topRepo_.removeByConnId(conn_id);
+    jobRepo_.removeByConnId(conn_id);
+    cmdRepo_.finishByConn(conn_id, "disconnected"); // Nobody will send their EXEC_DONE
+}
+
+void CommandRegistry::purge(int conn_id) {
+    cmdRepo_.removeByConn(conn_id);
+}
+
+void CommandRegistry::registerAuth_(DispatchTable& t) {
     // Register handler for authentication command
-    c.on(std::string(specula::CMD_AUTH),
-         [this](Connection& conn, const std::string& payload) {
-             if (payload == token_) {
+    t.on(specula::CMD_AUTH,
+         [this](Connection& conn, const Frame& f) {
+             // Payload: "<token>[ proto=<n>][ comp=lz]"
+             std::string_view payload = f.payload;
+             auto sp = payload.find_first_of(" \n");
+             std::string_view token = payload.substr(0, sp);
+             if (token == token_) {
                  // Authenticate connection if token matches
                  conn.isAuthenticated = true;
-                 conn.send(std::string(specula::RESP_OK), "agent\n");
+                 auto kv = parse_kv(sp == std::string_view::npos
+                                        ? std::string_view{}
+                                        : payload.substr(sp + 1));
+                 auto proto = kv.find(std::string(specula::PROTO_KEY));
+                 if (proto != kv.end() && proto->second == "2") {
+                     // The agent speaks v2: answer in text, then switch our
+                     // output; the agent switches when it reads this OK.
+                     // Compression needs v2 (the flag lives in its header).
+                     auto comp = kv.find(std::string(specula::COMP_KEY));
+                     const bool lz =
+                         comp != kv.end() && comp->second == specula::COMP_LZ;
+                     conn.send(specula::RESP_OK, lz ? "agent proto=2 comp=lz\n"
+                                                    : "agent proto=2\n");
+                     conn.setProtocol(specula::PROTO_BINARY);
+                     conn.setCompression(lz);
+                     // Have the agent push its stats instead of being polled
+                     conn.send(specula::CMD_SUBSCRIBE,
+                               std::string(specula::SUB_INTERVAL_KEY) + "=" +
+                                   std::to_string(specula::TELEMETRY_INTERVAL_MS) + " " +
+                                   std::string(specula::SUB_KEYFRAME_KEY) + "=" +
+                                   std::to_string(specula::TELEMETRY_KEYFRAME_EVERY) + "\n");
+                 } else {
+                     conn.send(specula::RESP_OK, "agent\n");
+                 }
              } else {
                  // Reject connection if token is invalid
                  conn.isAuthenticated = false;
-                 conn.send(std::string(specula::RESP_ERR), "unauthorized\n");
+                 conn.send(specula::RESP_ERR, "unauthorized\n");
              }
          });
 }
 
-void CommandRegistry::registerPing_(Connection& c) {
+void CommandRegistry::registerPing_(DispatchTable& t) {
     // Register handler for ping command
-    c.on(std::string(specula::CMD_PING),
-         [](Connection& conn, const std::string&) { conn.send("PONG", ""); });
+    t.on(specula::CMD_PING, [](Connection& conn, const Frame&) {
+        conn.send(specula::CMD_PONG, "");
+    });
 }
 
-void CommandRegistry::registerPong_(Connection& c) {
+void CommandRegistry::registerPong_(DispatchTable& t) {
     // Register handler for pong command (currently does nothing)
-    c.on("PONG", [](Connection&, const std::string&) {
+    t.on(specula::CMD_PONG, [](Connection&, const Frame&) {
     });
 }
 
-void CommandRegistry::registerStatus_(Connection& c) {
+void CommandRegistry::registerStatus_(DispatchTable& t) {
     // Register handler for status command
-    c.on(std::string(specula::CMD_STATUS), [this](Connection& conn,
-                                                  const std::string& payload) {
+    t.on(specula::CMD_STATUS, [this](Connection& conn,
+                                                  const Frame& f) {
         if (!conn.isAuthenticated) {
             // Reject if connection is not authenticated
-            conn.send(std::string(specula::RESP_ERR), "unauthorized\n");
+            conn.send(specula::RESP_ERR, "unauthorized\n");
             return;
         }
 
-        auto kv = parse_kv(payload); // Parse key-value pairs from payload
-        Stats s{};
-        s.conn_id = conn.getCfd(); // Set connection ID
-        if (kv.find("cpu") != kv.end()) {
-            // Parse CPU usage percentage
-            std::string cpu_str = kv["cpu"];
-            if (cpu_str.back() == '%') cpu_str.pop_back();
-            s.cpu_percent = std::stof(cpu_str);
+        // Text (v1) or binary (v2) encoding, depending on the frame flags
+        Stats s{conn.getId(), {}};
+        if (!decodeStatus(f, s.metrics)) return;
+        statsRepo_.upsert(std::move(s)); // Update stats repository with new data
+    });
+}
+
+void CommandRegistry::registerTelemetry_(DispatchTable& t) {
+    // Register handler for pushed telemetry; frames of one connection are
+    // handled in order, so the repo entry is the base each delta applies to
+    t.on(specula::CMD_TELEMETRY, [this](Connection& conn, const Frame& f) {
+        if (!conn.isAuthenticated) {
+            // Reject if connection is not authenticated
+            conn.send(specula::RESP_ERR, "unauthorized\n");
+            return;
         }
-        if (kv.find("mem") != kv.end()) {
-            // Parse memory usage (used/total)
-            std::string mem_str = kv["mem"];
-            auto slash = mem_str.find('/');
-            if (slash != std::string::npos) {
-                s.mem_used_bytes =
-                    std::stoull(mem_str.substr(0, slash)) * 1024;  // assume KB
-                s.mem_total_bytes =
-                    std::stoull(mem_str.substr(slash + 1)) * 1024;
-            }
+
+        // The published stats are immutable: the delta goes onto a copy
+        auto prev = statsRepo_.get(conn.getId());
+        Stats s = prev ? *prev : Stats{conn.getId(), {}};
+        bool keyframe = false;
+        if (!applyTelemetry(f.payload, s.metrics, keyframe)) return;
+        // A delta without a base would leave the other metrics missing: wait
+        // for the next keyframe
+        if (!keyframe && !prev) return;
+        statsRepo_.upsert(std::move(s));
+    });
+}
+
+void CommandRegistry::registerTop_(DispatchTable& t) {
+    // Register handler for the agent's reply to TOP
+    t.on(specula::CMD_TOP, [this](Connection& conn, const Frame& f) {
+        if (!conn.isAuthenticated) {
+            // Reject if connection is not authenticated
+            conn.send(specula::RESP_ERR, "unauthorized\n");
+            return;
         }
-        if (kv.find("disk") != kv.end()) {
-            // Parse disk usage (used/total)
-            std::string disk_str = kv["disk"];
-            auto slash = disk_str.find('/');
-            if (slash != std::string::npos) {
-                s.disk_used_bytes =
-                    std::stoull(disk_str.substr(0, slash)) * 1024;  // assume KB
-                s.disk_total_bytes =
-                    std::stoull(disk_str.substr(slash + 1)) * 1024;
-            }
+        std::vector<ProcInfo> procs;
+        if (!decodeTop(f, procs)) return;
+        topRepo_.put(conn.getId(), std::move(procs)); // Wakes the console waiting for it
+    });
+}
+
+void CommandRegistry::registerExecList_(DispatchTable& t) {
+    // Register handler for job list replies
+    t.on(specula::CMD_EXEC_LIST, [this](Connection& conn, const Frame& f) {
+        if (!conn.isAuthenticated) {
+            // Reject if connection is not authenticated
+            conn.send(specula::RESP_ERR, "unauthorized\n");
+            return;
         }
-        statsRepo_.upsert(s); // Update stats repository with new data
+        std::vector<JobInfo> jobs;
+        if (!decodeJobs(f, jobs)) return;
+        jobRepo_.put(conn.getId(), std::move(jobs)); // Wakes the console waiting for it
+    });
+}
+
+void CommandRegistry::registerErr_(DispatchTable& t) {
+    // Register handler for errors reported by the agent (e.g. EXEC_KILL of an
+    // unknown id); logged, never answered, so two peers cannot ping-pong ERRs
+    t.on(specula::RESP_ERR, [](Connection& conn, const Frame& f) {
+        std::cerr << "[command_registry] conn=" << conn.getId()
+                  << " error: " << f.payload;
     });
 }
 
-void CommandRegistry::registerBye_(Connection& c) {
+void CommandRegistry::registerBye_(DispatchTable& t) {
     // Register handler for bye command
-    c.on(std::string(specula::CMD_BYE),
-         [](Connection& conn, const std::string&) {
-             conn.send("OK", "bye\n"); // Send goodbye response
-         });
+    t.on(specula::CMD_BYE, [](Connection& conn, const Frame&) {
+        conn.send(specula::RESP_OK, "bye\n"); // Send goodbye response
+    });
 }
 
-void CommandRegistry::registerExecOut_(Connection& c) {
+void CommandRegistry::registerExecOut_(DispatchTable& t) {
     // Register handler for execution output command
-    c.on("EXEC_OUT", [this](Connection& conn, const std::string& payload) {
+    t.on(specula::CMD_EXEC_OUT, [this](Connection& conn,
+                                                    const Frame& f) {
         if (!conn.isAuthenticated) {
             // Reject if connection is not authenticated
-            conn.send(std::string(specula::RESP_ERR), "unauthorized\n");
+            conn.send(specula::RESP_ERR, "unauthorized\n");
             return;
         }
-        auto nl = payload.find('\n'); // Find newline separating options and chunk
-        std::string opts =
-            (nl == std::string::npos) ? payload : payload.substr(0, nl);
-        std::string chunk =
-            (nl == std::string::npos) ? "" : payload.substr(nl + 1);
 
-        auto kv = parse_kv(opts); // Parse key-value pairs from options
         int id = 0;
-        try {
-            if (kv.count("id")) id = std::stoi(kv["id"]);
-        } catch (...) {
+        std::string_view chunk;
+        bool err = false;
+        if (f.requestId) {
+            // v2: the id and stream travel in the header and the payload is
+            // the raw chunk
+            id = static_cast<int>(f.requestId);
+            chunk = f.payload;
+            err = f.flags & specula::FLAG_STDERR;
+        } else {
+            auto nl = f.payload.find('\n'); // Find newline separating options and chunk
+            std::string_view opts =
+                (nl == std::string_view::npos) ? f.payload : f.payload.substr(0, nl);
+            chunk = (nl == std::string_view::npos) ? std::string_view{}
+                                                   : f.payload.substr(nl + 1);
+
+            auto kv = parse_kv(opts); // Parse key-value pairs from options
+            try {
+                if (kv.count("id")) id = std::stoi(kv["id"]);
+            } catch (...) {
+            }
+            auto s = kv.find(std::string(specula::EXEC_STREAM_KEY));
+            err = s != kv.end() && s->second == specula::EXEC_STREAM_ERR;
         }
 
         if (id <= 0 || chunk.empty()) {
@@ -128,49 +228,63 @@ void CommandRegistry::registerExecOut_(Connection& c) {
             return;
         }
 
-        if (!cmdRepo_.appendOut(id, chunk)) {
+        if (!cmdRepo_.appendOut(id, chunk, err)) {
             // Append output to command repository
-            conn.send(std::string(specula::RESP_ERR), "invalid_id\n");
+            conn.send(specula::RESP_ERR, "invalid_id\n");
             return;
         }
+
+        // Chunk consumed: return its credit so the agent keeps streaming
+        if (size_t credit = cmdRepo_.takeCredit(id)) {
+            conn.send(specula::CMD_EXEC_CREDIT,
+                      "id=" + std::to_string(id) +
+                          " bytes=" + std::to_string(credit) + "\n",
+                      static_cast<uint32_t>(id));
+        }
     });
 }
 
-void CommandRegistry::registerExecDone_(Connection& c) {
+void CommandRegistry::registerExecDone_(DispatchTable& t) {
     // Register handler for execution done command
-    c.on("EXEC_DONE", [this](Connection& conn, const std::string& payload) {
+    t.on(specula::CMD_EXEC_DONE, [this](Connection& conn,
+                                                     const Frame& f) {
         if (!conn.isAuthenticated) {
             // Reject if connection is not authenticated
-            conn.send(std::string(specula::RESP_ERR), "unauthorized\n");
+            conn.send(specula::RESP_ERR, "unauthorized\n");
             return;
         }
-        auto kv = parse_kv(payload); // Parse key-value pairs from payload
-        int id = 0;
+        auto kv = parse_kv(f.payload); // Parse key-value pairs from payload
+        int id = static_cast<int>(f.requestId); // v2 carries the id in the header
         int code = -1;
+        int signal = 0;
         try {
             if (kv.count("id")) id = std::stoi(kv["id"]);
             if (kv.count("code")) code = std::stoi(kv["code"]);
+            auto s = kv.find(std::string(specula::EXEC_SIGNAL_KEY));
+            if (s != kv.end()) signal = std::stoi(s->second);
         } catch (...) {
         }
+        auto reason = kv.find(std::string(specula::EXEC_REASON_KEY));
 
         if (id <= 0 || code < 0) {
             // Ignore invalid ID or code
             return;
         }
 
-        if (!cmdRepo_.done(id, code)) {
+        if (!cmdRepo_.done(id, code, signal,
+                           reason != kv.end() ? reason->second : std::string())) {
             // Mark command as done in repository
-            conn.send(std::string(specula::RESP_ERR), "invalid_id\n");
+            conn.send(specula::RESP_ERR, "invalid_id\n");
             return;
         }
     });
 }
 
-void CommandRegistry::registerDefault_(Connection& c) {
+void CommandRegistry::registerDefault_(DispatchTable& t) {
     // Register default handler for unknown commands
-    c.setDefaultHandler([](Connection& conn, const std::string& payload) {
-        std::cerr << "[command_registry] unknown command: payload='" << payload
-                  << "'\n";
-        conn.send(std::string(specula::RESP_ERR), "unknown_cmd\n");
+    t.setDefault([](Connection& conn, const Frame& f) {
+        std::cerr << "[command_registry] unknown command: cmd='" << f.cmd
+                  << "' payload='" << f.payload << "'\n";
+        conn.send(specula::RESP_ERR, "unknown_cmd\n");
     });
 }
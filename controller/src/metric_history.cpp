@@ -0,0 +1,118 @@
+#include "../include/metric_history.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+int64_t toMs(MetricHistory::clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch())
+        .count();
+}
+}  // namespace
+
+MetricHistory::MetricHistory(size_t capacity, size_t maxSeries)
+    : cap_(std::max<size_t>(capacity, 1)), maxSeries_(maxSeries), ts_(cap_) {}
+
+uint32_t MetricHistory::seriesOf(uint32_t id, const MetricSet& m) {
+    auto it = std::lower_bound(
+        idCache_.begin(), idCache_.end(), id,
+        [](const std::pair<uint32_t, uint32_t>& e, uint32_t x) { return e.first < x; });
+    if (it != idCache_.end() && it->first == id) return it->second;
+
+    std::string name = m.nameOf(id);
+    uint32_t s = kNoSeries;
+    auto n = byName_.find(name);
+    if (n != byName_.end()) {
+        s = n->second;
+    } else if (names_.size() < maxSeries_) {
+        s = static_cast<uint32_t>(names_.size());
+        values_.resize(values_.size() + cap_, kMissing);
+        scales_.push_back(metric::info(metric::kindOf(id)).scale);
+        byName_.emplace(name, s);
+        names_.push_back(std::move(name));
+    }
+    idCache_.insert(it, {id, s});
+    return s;
+}
+
+void MetricHistory::append(clock::time_point t, const MetricSet& m) {
+    // instance numbers of labelled kinds are only valid for one label table:
+    // checked once per sample, seriesOf() then only looks up idCache_
+    if (m.labels() != lastLabels_) {
+        lastLabels_ = m.labels();
+        idCache_.clear();
+    }
+
+    const size_t at = head_;
+    ts_[at] = toMs(t);
+    for (size_t s = 0; s < names_.size(); ++s) values_[s * cap_ + at] = kMissing;
+    for (const auto& e : m.entries()) {
+        const uint32_t s = seriesOf(e.id, m);
+        if (s != kNoSeries) values_[s * cap_ + at] = e.value;
+    }
+    head_ = (head_ + 1) % cap_;
+    if (size_ < cap_) ++size_;
+}
+
+bool MetricHistory::query(std::string_view series, clock::time_point from,
+                          clock::time_point to, std::chrono::milliseconds step,
+                          std::vector<Point>& out) const {
+    out.clear();
+    auto n = byName_.find(std::string(series));
+    if (n == byName_.end()) return false;
+    if (size_ == 0 || to < from) return true;
+
+    const uint64_t* col = values_.data() + n->second * cap_;
+    const double scale = scales_[n->second];
+    const int64_t lo = toMs(from), hi = toMs(to);
+    const int64_t width = std::max<int64_t>(step.count(), 1);
+
+    // timestamps ascend in ring order: binary search the first one in range
+    size_t first = 0, count = size_;
+    while (count > 0) {
+        const size_t half = count / 2;
+        if (ts_[slot(first + half)] < lo) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+
+    int64_t bucket = -1;
+    uint64_t mn = 0, mx = 0;
+    double sum = 0;
+    uint32_t k = 0;
+    auto emit = [&] {
+        if (!k) return;
+        Point p;
+        p.t = from + std::chrono::milliseconds(bucket * width);
+        p.count = k;
+        p.min = mn / scale;
+        p.max = mx / scale;
+        p.mean = sum / k / scale;
+        out.push_back(p);
+    };
+    for (size_t i = first; i < size_; ++i) {
+        const size_t at = slot(i);
+        const int64_t t = ts_[at];
+        if (t > hi) break;
+        const uint64_t v = col[at];
+        if (v == kMissing) continue;
+        const int64_t b = (t - lo) / width;
+        if (b != bucket) {
+            emit();
+            bucket = b;
+            mn = std::numeric_limits<uint64_t>::max();
+            mx = 0;
+            sum = 0;
+            k = 0;
+        }
+        mn = std::min(mn, v);
+        mx = std::max(mx, v);
+        sum += static_cast<double>(v);
+        ++k;
+    }
+    emit();
+    return true;
+}
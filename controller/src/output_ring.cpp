@@ -0,0 +1,41 @@
+#include "../include/output_ring.h"
+
+#include <cstring>
+
+OutputRing::OutputRing(size_t limit) : limit_(limit) {}
+
+void OutputRing::append(std::string_view data) {
+    while (!data.empty()) {
+        if (end_ - base_ == blocks_.size() * kBlockSize) {
+            // last block full (or none yet): reuse the spare if there is one
+            blocks_.push_back(spare_ ? std::move(spare_) : Block(new char[kBlockSize]));
+        }
+        const size_t in = (end_ - base_) % kBlockSize;
+        const size_t n = std::min(kBlockSize - in, data.size());
+        std::memcpy(blocks_.back().get() + in, data.data(), n);
+        data.remove_prefix(n);
+        end_ += n;
+    }
+    trim_();
+}
+
+size_t OutputRing::read(size_t offset, std::string& out, size_t max) const {
+    const size_t from = std::max(offset, head_);
+    if (from < end_) out.reserve(out.size() + std::min(max, end_ - from));
+    return forEach(offset, max, [&](std::string_view s) { out.append(s); });
+}
+
+void OutputRing::setLimit(size_t limit) {
+    limit_ = limit;
+    trim_();
+}
+
+void OutputRing::trim_() {
+    if (end_ - head_ > limit_) head_ = end_ - limit_;
+    // drop the blocks that hold no retained byte
+    while (!blocks_.empty() && head_ - base_ >= kBlockSize) {
+        spare_ = std::move(blocks_.front());
+        blocks_.pop_front();
+        base_ += kBlockSize;
+    }
+}
@@ -1,8 +1,10 @@
 #include "../include/scheduler.h"
 
-#include <thread>
+#include <algorithm>
+#include <functional>
 
-Scheduler::Scheduler() {
+Scheduler::Scheduler(WorkerPool& pool)
+    : pool_(pool), rng_(std::random_device{}()) {
     // Start the scheduler thread that runs the loop
     thr_ = std::thread([this] { loop_(); });
 }
@@ -10,41 +12,127 @@ Scheduler::~Scheduler() {
     stop(); // Ensure the scheduler is stopped and cleaned up
 }
 
-int Scheduler::every(ms interval, Job job) {
+int Scheduler::every(ms interval, Job job, ms jitter) {
     std::lock_guard<std::mutex> lk(mx_); // Lock to ensure thread safety
-    int id = next_id_++; // Generate a unique ID for the job
-    items_[id] = Item{id, interval, std::move(job),
-                      std::chrono::steady_clock::now() + interval, true}; // Schedule the job
-    return id; // Return the job ID
+    interval = std::max(interval, ms(1)); // 0 would mean a one-shot job
+    return add_(interval, interval, jitter, std::move(job));
+}
+int Scheduler::after(ms delay, Job job) {
+    std::lock_guard<std::mutex> lk(mx_); // Lock to ensure thread safety
+    return add_(delay, ms(0), ms(0), std::move(job));
 }
 void Scheduler::cancel(int id) {
     std::lock_guard<std::mutex> lk(mx_); // Lock to ensure thread safety
-    items_.erase(id); // Remove the job from the schedule
+    auto it = items_.find(id);
+    if (it == items_.end()) return;
+    if (it->second.armed) ++stale_; // Its heap entry is skipped when it comes up
+    items_.erase(it); // Remove the job from the schedule
+
+    // Mostly cancelled entries: rebuild the heap with the live ones only
+    if (stale_ > 64 && stale_ * 2 > heap_.size()) {
+        heap_.erase(std::remove_if(heap_.begin(), heap_.end(),
+                                   [&](const Deadline& d) { return !items_.count(d.id); }),
+                    heap_.end());
+        std::make_heap(heap_.begin(), heap_.end(), std::greater<Deadline>());
+        stale_ = 0;
+    }
 }
 void Scheduler::stop() {
-    if (!running_.exchange(false)) return; // Stop the loop if it is running
+    std::unique_lock<std::mutex> lk(mx_);
+    if (!running_) return; // Stop the loop if it is running
+    running_ = false;
+    cv_.notify_all();
+    lk.unlock();
     if (thr_.joinable()) thr_.join(); // Wait for the thread to finish
-    std::lock_guard<std::mutex> lk(mx_); // Lock to ensure thread safety
+
+    lk.lock();
+    cv_.wait(lk, [&] { return inFlight_ == 0; }); // Jobs still running on the pool
     items_.clear(); // Clear all scheduled jobs
+    heap_.clear();
+    stale_ = 0;
+}
+size_t Scheduler::size() const {
+    std::lock_guard<std::mutex> lk(mx_); // Lock to ensure thread safety
+    return items_.size();
+}
+
+int Scheduler::add_(ms delay, ms interval, ms jitter, Job job) {
+    int id = next_id_++; // Generate a unique ID for the job
+    const auto base = clock::now() + delay;
+    items_.emplace(id, Item{interval, jitter, std::make_shared<const Job>(std::move(job)), base, true});
+    arm_(id, base + jitter_(jitter)); // Schedule the job
+    return id; // Return the job ID
 }
+void Scheduler::arm_(int id, clock::time_point due) {
+    heap_.push_back(Deadline{due, id});
+    std::push_heap(heap_.begin(), heap_.end(), std::greater<Deadline>());
+    if (heap_.front().id == id) cv_.notify_one(); // The loop sleeps until a later deadline
+}
+Scheduler::ms Scheduler::jitter_(ms jitter) {
+    if (jitter.count() <= 0) return ms(0);
+    std::uniform_int_distribution<ms::rep> dist(0, jitter.count());
+    return ms(dist(rng_));
+}
+
+void Scheduler::dispatch_(int id, const std::shared_ptr<const Job>& job) {
+    try {
+        (*job)(); // Execute the job
+    } catch (...) {
+        // Catch and ignore any exceptions thrown by the job
+    }
+
+    std::lock_guard<std::mutex> lk(mx_);
+    --inFlight_;
+    auto it = items_.find(id);
+    if (running_ && it != items_.end()) {
+        // Periodic job not cancelled meanwhile: next run one interval after
+        // this one was due, or now if it ran late (no burst to catch up);
+        // jitter is added to each run, not accumulated
+        Item& item = it->second;
+        item.base = std::max(item.base + item.interval, clock::now());
+        item.armed = true;
+        arm_(id, item.base + jitter_(item.jitter));
+    }
+    if (!running_) cv_.notify_all(); // stop() waits for inFlight_ == 0
+}
+
 void Scheduler::loop_() {
-    using clock = std::chrono::steady_clock;
-    while (running_.load()) { // Continue running while the scheduler is active
-        auto now = clock::now(); // Get the current time
-        {
-            std::lock_guard<std::mutex> lk(mx_); // Lock to ensure thread safety
-            for (auto& [id, it] : items_) { // Iterate over all scheduled jobs
-                if (!it.active) continue; // Skip inactive jobs
-                if (now >= it.next) { // Check if the job is due to run
-                    try {
-                        it.job(); // Execute the job
-                    } catch (...) {
-                        // Catch and ignore any exceptions thrown by the job
-                    }
-                    it.next = now + it.interval; // Schedule the next execution
-                }
-            }
+    std::unique_lock<std::mutex> lk(mx_);
+    while (running_) { // Continue running while the scheduler is active
+        // Drop the entries of cancelled jobs
+        while (!heap_.empty() && !items_.count(heap_.front().id)) {
+            std::pop_heap(heap_.begin(), heap_.end(), std::greater<Deadline>());
+            heap_.pop_back();
+            --stale_;
+        }
+        if (heap_.empty()) {
+            cv_.wait(lk); // Until a job is added or the scheduler stops
+            continue;
+        }
+        const Deadline top = heap_.front();
+        if (clock::now() < top.due) {
+            cv_.wait_until(lk, top.due); // Or an earlier deadline arrives
+            continue;
+        }
+
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<Deadline>());
+        heap_.pop_back();
+        auto it = items_.find(top.id);
+        std::shared_ptr<const Job> job = it->second.job;
+        if (it->second.interval.count() == 0)
+            items_.erase(it); // One-shot: its id is done once it runs
+        else
+            it->second.armed = false; // Re-armed by dispatch_() when the run ends
+        ++inFlight_;
+
+        // submit() blocks while the pool's queue is full: not under the lock
+        lk.unlock();
+        const bool queued = pool_.submit(
+            [this, id = top.id, job = std::move(job)] { dispatch_(id, job); });
+        lk.lock();
+        if (!queued) {
+            --inFlight_; // Pool stopped: the job is dropped
+            items_.erase(top.id);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Sleep briefly to avoid busy-waiting
     }
 }
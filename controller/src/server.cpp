@@ -2,14 +2,19 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <iostream>
 
-// Server constructor that initializes the registry_ member variable
-Server::Server(CommandRegistry& registry) : registry_(registry) {}
+// Server constructor that initializes the registry_ member variable and, unless
+// ioThreads is 0, the event loops that will drive the connections
+Server::Server(CommandRegistry& registry, size_t ioThreads)
+    : registry_(registry),
+      loops_(ioThreads ? std::make_unique<EventLoopGroup>(ioThreads) : nullptr) {}
 
 // Server destructor that stops the server
 Server::~Server() { stop(); }
@@ -59,31 +64,37 @@ optional<Server::Endpoint> Server::resolveEndpointFromFd(int fd) {
     return ep;
 }
 
-void Server::setEndpoint(int conn_id, Endpoint ep) {
-    std::lock_guard<std::mutex> lk(ep_mtx_);
-    endpoints_[conn_id] = std::move(ep);
-}
-
-void Server::eraseEndpoint(int conn_id) {
-    std::lock_guard<std::mutex> lk(ep_mtx_);
-    endpoints_.erase(conn_id);
-}
-
 std::optional<Server::Endpoint> Server::getEndpoint(int conn_id) const {
-    std::lock_guard<std::mutex> lk(ep_mtx_);
-    auto it = endpoints_.find(conn_id);
-    if (it == endpoints_.end()) return std::nullopt;
-    return it->second;
+    std::lock_guard<std::mutex> lk(conns_mtx_);
+    auto it = conns_.find(conn_id);
+    if (it == conns_.end()) return std::nullopt;
+    return it->second.ep;
 }
 
 std::vector<std::pair<int, Server::Endpoint>> Server::listEndpoints() const {
     std::vector<std::pair<int, Server::Endpoint>> out;
-    std::lock_guard<std::mutex> lk(ep_mtx_);
-    out.reserve(endpoints_.size());
-    for (auto& [id, ep] : endpoints_) out.emplace_back(id, ep);
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        out.reserve(conns_.size());
+        for (auto& [id, e] : conns_)
+            if (e.ep && e.conn->isRunning()) out.emplace_back(id, *e.ep);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
     return out;
 }
 
+size_t Server::connectionCount() const {
+    std::lock_guard<std::mutex> lk(conns_mtx_);
+    return conns_.size();
+}
+
+std::shared_ptr<Connection> Server::find_(int conn_id) const {
+    std::lock_guard<std::mutex> lk(conns_mtx_);
+    auto it = conns_.find(conn_id);
+    return it == conns_.end() ? nullptr : it->second.conn;
+}
+
 // Starts the server, binding to the given port and address
 bool Server::start(uint16_t port, const std::string& bindAddr) {
     // Attempt to open the listener on the specified port and address
@@ -92,6 +103,28 @@ bool Server::start(uint16_t port, const std::string& bindAddr) {
         return false;
     }
     running_ = true;
+    reaper_thr_ = std::thread([this] { reap_(); });
+
+    if (loops_) {
+        // Event loop mode: the listener lives on the first loop and every
+        // accepted connection is assigned to a loop in round-robin order
+        listener_.setNonBlocking();
+        if (!loops_->start() ||
+            !loops_->at(0).add(listener_.fd(), EPOLLIN,
+                               [this](uint32_t) { acceptPending_(); })) {
+            std::cerr << "[server] event loop setup failed\n";
+            running_ = false;
+            {
+                std::lock_guard<std::mutex> lk(reap_mtx_);
+                reap_cv_.notify_all();
+            }
+            reaper_thr_.join();
+            loops_->stop();
+            listener_.close();
+            return false;
+        }
+        return true;
+    }
 
     // Create a thread to accept incoming connections
     accept_thr_ = std::thread([this]() {
@@ -108,55 +141,142 @@ bool Server::start(uint16_t port, const std::string& bindAddr) {
                 continue;  // Otherwise, continue to the next iteration to
                            // accept new connections
             }
-
-            // Create a shared pointer for the new connection
-            auto conn = std::make_shared<Connection>(cfd);
-            registry_.attach(*conn);  // Attach the connection to the registry
-            conn->start();            // Start the connection
-            conns_.add(conn);  // Add the connection to the connection manager
-            if (auto ep = resolveEndpointFromFd(cfd)) {
-                setEndpoint(cfd, *ep);
-            }
+            onAccepted_(cfd);
         }
     });
     return true;
 }
 
+// Drains the accept queue of the non-blocking listener (edge-triggered)
+void Server::acceptPending_() {
+    while (running_.load()) {
+        int cfd = listener_.tryAccept();
+        if (cfd < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN: queue drained; anything else (e.g. EMFILE) is retried on
+            // the next readiness edge
+            return;
+        }
+        onAccepted_(cfd);
+    }
+}
+
+// Creates the Connection for an accepted fd and starts it
+void Server::onAccepted_(int cfd) {
+    const int id = next_id_++;
+    // Create a shared pointer for the new connection
+    auto conn = std::make_shared<Connection>(cfd);
+    conn->setId(id);
+    registry_.attach(*conn);  // Attach the connection to the registry
+    conn->setOnClose([this, id] { onClosed_(id); });
+    Entry e{conn, resolveEndpointFromFd(cfd)};
+    {
+        // In the table before it starts, so its close hook always finds it
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        conns_.emplace(id, std::move(e));
+    }
+    if (loops_)
+        conn->start(loops_->next());  // Drive it from one of the I/O loops
+    else
+        conn->start();  // Start the connection's reader thread
+    if (!conn->isRunning()) onClosed_(id);  // could not be registered
+}
+
+// Queues a closed connection for the reaper; runs on the connection's I/O
+// loop, which must not stop() it
+void Server::onClosed_(int conn_id) {
+    {
+        std::lock_guard<std::mutex> lk(reap_mtx_);
+        closed_.push_back(conn_id);
+    }
+    reap_cv_.notify_one();
+}
+
+// Stops closed connections, drops them from the table and the repos, and
+// purges their command records once nobody can still be waiting on them
+void Server::reap_() {
+    // the CLI waits at most a few minutes on a command (exec timeout + slack)
+    constexpr auto kPurgeAfter = std::chrono::minutes(10);
+
+    std::unique_lock<std::mutex> lk(reap_mtx_);
+    while (running_.load()) {
+        if (closed_.empty()) {
+            if (purge_.empty())
+                reap_cv_.wait(lk);
+            else
+                reap_cv_.wait_until(lk, purge_.front().first);
+        }
+
+        std::deque<int> closed;
+        closed.swap(closed_);
+        std::vector<int> due;
+        const auto now = clock::now();
+        while (!purge_.empty() && purge_.front().first <= now) {
+            due.push_back(purge_.front().second);
+            purge_.pop_front();
+        }
+        lk.unlock();
+
+        for (int id : closed) {
+            std::shared_ptr<Connection> conn;
+            {
+                std::lock_guard<std::mutex> tl(conns_mtx_);
+                auto it = conns_.find(id);
+                if (it == conns_.end()) continue;
+                conn = std::move(it->second.conn);
+                conns_.erase(it);
+            }
+            conn->stop();  // Waits for its handlers, closes the fd
+            registry_.detach(id);
+        }
+        for (int id : due) registry_.purge(id);
+
+        lk.lock();
+        for (int id : closed) purge_.emplace_back(now + kPurgeAfter, id);
+    }
+}
+
 // Stops the server, closing the listener and joining the accept thread
 void Server::stop() {
     // Exchange the running_ atomic flag to false, returning the previous value
     if (!running_.exchange(false)) return;
 
+    // Unregister the listener first so no accept can race the shutdown below
+    if (loops_) loops_->at(0).remove(listener_.fd());
     listener_.close();  // Close the listener to stop accepting new connections
 
     // Join the accept thread if it is joinable
     if (accept_thr_.joinable()) accept_thr_.join();
 
+    // Join the reaper; connections still in the table are stopped below
+    {
+        std::lock_guard<std::mutex> lk(reap_mtx_);
+        reap_cv_.notify_all();
+    }
+    if (reaper_thr_.joinable()) reaper_thr_.join();
+
     // Stop all active connections
-    conns_.for_each([](auto& sp) {
-        if (sp) sp->stop();
-    });
+    std::vector<std::shared_ptr<Connection>> conns;
+    {
+        std::lock_guard<std::mutex> lk(conns_mtx_);
+        for (auto& [id, e] : conns_) conns.push_back(e.conn);
+    }
+    for (auto& c : conns) c->stop();
+
+    // Finally stop the I/O loops
+    if (loops_) loops_->stop();
 }
 
 // Broadcasts a message to all connected clients
 void Server::broadcast(const std::string& cmd, const std::string& payload) {
-    conns_.for_each([&](auto& sp) {
-        // Send the message to each active connection
-        if (sp && sp->isRunning()) {
-            sp->send(cmd, payload);
-        }
+    forEachConn([&](Connection& c) {
+        c.send(cmd, payload);  // send() only queues the frame
     });
 }
 
 // Sends a message to a specific client identified by conn_id
 bool Server::send(const std::string& cmd, const std::string& payload,
                   int conn_id) {
-    bool sent = false;
-    conns_.for_each([&](auto& sp) {
-        // Send the message if the connection is active and matches the conn_id
-        if (sp && sp->isRunning() && sp->getCfd() == conn_id) {
-            sent = sp->send(cmd, payload);
-        }
-    });
-    return sent;
+    auto conn = find_(conn_id);
+    return conn && conn->isRunning() && conn->send(cmd, payload);
 }
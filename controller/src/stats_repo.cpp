@@ -1,44 +1,100 @@
 #include "../include/stats_repo.h"
 
 #include <algorithm>
+#include <utility>
 
-// Upsert function either updates an existing Stats object or adds a new one
-// if no object with the same conn_id exists.
-void StatsRepo::upsert(const Stats& s) {
-    std::lock_guard<std::mutex> lk(mx_); // Locking the mutex to ensure thread safety
-    // Find if the Stats object with the same conn_id already exists
-    auto it = std::find_if(data_.begin(), data_.end(), [&](const Stats& x) {
-        return x.conn_id == s.conn_id;
-    });
-    // If found, update the existing object, otherwise add the new object to the data_
-    if (it != data_.end())
-        *it = s;
-    else
-        data_.push_back(s);
+StatsRepo::StatsRepo(size_t historySamples) : historySamples_(historySamples) {}
+
+// find function looks up the slot of the given conn_id in its shard's index.
+StatsRepo::SlotPtr StatsRepo::find(int id) const {
+    IndexPtr idx = std::atomic_load(&shardOf(id).index);
+    auto it = idx->find(id);
+    return it == idx->end() ? nullptr : it->second;
+}
+
+// Upsert function publishes s as the latest stats of its conn_id, adding a
+// slot if the agent is new, and records it in the history.
+void StatsRepo::upsert(Stats s) {
+    const auto now = MetricHistory::clock::now();
+    const int id = s.conn_id;
+    auto next = std::make_shared<const Stats>(std::move(s));
+
+    SlotPtr slot = find(id);
+    if (!slot) {
+        // New agent: publish a copy of the shard's index with its slot added
+        Shard& sh = shardOf(id);
+        std::lock_guard<std::mutex> lk(sh.mx);
+        IndexPtr cur = std::atomic_load(&sh.index);
+        auto it = cur->find(id);
+        if (it != cur->end()) {
+            slot = it->second;  // added meanwhile
+        } else {
+            auto idx = std::make_shared<Index>(*cur);
+            slot = std::make_shared<Slot>(historySamples_);
+            idx->emplace(id, slot);
+            std::atomic_store(&sh.index, IndexPtr(std::move(idx)));
+        }
+    }
+
+    if (historySamples_) {
+        // Only a history query on this same agent can wait here
+        std::lock_guard<std::mutex> lk(slot->historyMx);
+        slot->history.append(now, next->metrics);
+    }
+    std::atomic_store(&slot->stats, StatsPtr(std::move(next)));
 }
 
-// removeByConnId function removes the Stats object associated with the given conn_id.
+// removeByConnId function removes the slot (stats and history) of the given conn_id.
 void StatsRepo::removeByConnId(int id) {
-    std::lock_guard<std::mutex> lk(mx_); // Locking the mutex to ensure thread safety
-    // Remove the Stats object where conn_id matches the given id
-    data_.erase(std::remove_if(data_.begin(), data_.end(),
-                               [&](const Stats& x) { return x.conn_id == id; }),
-                data_.end());
+    Shard& sh = shardOf(id);
+    std::lock_guard<std::mutex> lk(sh.mx);
+    IndexPtr cur = std::atomic_load(&sh.index);
+    if (!cur->count(id)) return;
+    auto idx = std::make_shared<Index>(*cur);
+    idx->erase(id);
+    std::atomic_store(&sh.index, IndexPtr(std::move(idx)));
+}
+
+// snapshot function returns the latest stats of every agent that has reported.
+std::vector<StatsRepo::StatsPtr> StatsRepo::snapshot() const {
+    std::vector<StatsPtr> out;
+    for (const Shard& sh : shards_) {
+        IndexPtr idx = std::atomic_load(&sh.index);
+        for (const auto& [id, slot] : *idx) {
+            StatsPtr s = std::atomic_load(&slot->stats);
+            if (s) out.push_back(std::move(s));  // null until its first upsert completes
+        }
+    }
+    std::sort(out.begin(), out.end(),
+              [](const StatsPtr& a, const StatsPtr& b) { return a->conn_id < b->conn_id; });
+    return out;
+}
+
+// get function retrieves the latest stats of the given conn_id.
+StatsRepo::StatsPtr StatsRepo::get(int id) const {
+    SlotPtr slot = find(id);
+    return slot ? std::atomic_load(&slot->stats) : nullptr;
 }
 
-// snapshot function returns a copy of the current data_ vector.
-std::vector<Stats> StatsRepo::snapshot() const {
-    std::lock_guard<std::mutex> lk(mx_); // Locking the mutex to ensure thread safety
-    return data_; // Return a copy of the data_
+// history function aggregates one series of the agent's history.
+bool StatsRepo::history(int conn_id, std::string_view series,
+                        MetricHistory::clock::time_point from,
+                        MetricHistory::clock::time_point to,
+                        std::chrono::milliseconds step,
+                        std::vector<MetricHistory::Point>& out) const {
+    SlotPtr slot = historySamples_ ? find(conn_id) : nullptr;
+    if (!slot) {
+        out.clear();
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(slot->historyMx);
+    return slot->history.query(series, from, to, step, out);
 }
 
-// get function retrieves the Stats object associated with the given conn_id.
-std::optional<Stats> StatsRepo::get(int id) const {
-    std::lock_guard<std::mutex> lk(mx_); // Locking the mutex to ensure thread safety
-    // Find the Stats object with the matching conn_id
-    auto it = std::find_if(data_.begin(), data_.end(),
-                           [&](const Stats& x) { return x.conn_id == id; });
-    // If not found, return std::nullopt, otherwise return the found object
-    if (it == data_.end()) return std::nullopt;
-    return *it;
+// historySeries function lists the series recorded for the given conn_id.
+std::vector<std::string> StatsRepo::historySeries(int conn_id) const {
+    SlotPtr slot = historySamples_ ? find(conn_id) : nullptr;
+    if (!slot) return {};
+    std::lock_guard<std::mutex> lk(slot->historyMx);
+    return slot->history.series();
 }
@@ -1,11 +1,23 @@
 #pragma once
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
+
+#include "dispatch_table.h"
+#include "framing.h"
+#include "metrics.h"
+#include "rx_buffer.h"
+
+class EventLoop;
+class WorkerPool;
 
 /**
  * @brief Manages a socket connection, providing thread-safe send/receive and
@@ -13,12 +25,9 @@
  */
 class Connection {
    public:
-    /**
-     * @brief Handler type for processing received commands.
-     * @param conn Reference to the current Connection object.
-     * @param payload The full payload received.
-     */
-    using Handler = std::function<void(Connection&, const std::string&)>;
+    using Handler = DispatchTable::Handler;
+    using Dispatch = DispatchTable::Mode;
+    using Clock = std::chrono::steady_clock;
 
     /**
      * @brief Constructs a Connection from an already connected socket file
@@ -29,7 +38,7 @@ class Connection {
     explicit Connection(int fd);
 
     /**
-     * @brief Destructor. Closes the socket and stops the reader thread.
+     * @brief Destructor. Closes the socket and stops the I/O thread.
      */
     ~Connection();
 
@@ -39,12 +48,29 @@ class Connection {
     Connection& operator=(Connection&&) = delete;
 
     /**
-     * @brief Starts the reader thread to process incoming data.
+     * @brief Starts a dedicated I/O thread (a private EventLoop) for this
+     * connection.
      */
     void start();
 
     /**
-     * @brief Stops the reader thread and closes the socket.
+     * @brief Starts the connection on a shared event loop instead of a
+     * dedicated I/O thread.
+     *
+     * The socket is switched to non-blocking mode and registered
+     * (edge-triggered) with @p loop, which must outlive the connection or at
+     * least the call to stop().
+     * @param loop Event loop that will drive reads and writes for this
+     * connection.
+     */
+    void start(EventLoop& loop);
+
+    /**
+     * @brief Stops the I/O and closes the socket.
+     *
+     * Waits for handlers of this connection that are already running on the
+     * worker pool (frames still queued are discarded), then makes a last
+     * non-blocking attempt to flush the outbound queue.
      */
     void stop();
 
@@ -55,25 +81,156 @@ class Connection {
     bool isRunning() const noexcept;
 
     /**
-     * @brief Sends a command and payload in a thread-safe manner.
+     * @brief Queues a command and payload for sending; never blocks on the
+     * socket.
+     *
+     * The frame is appended to one of the connection's two outbound lanes and
+     * written by the event loop with vectored I/O, coalescing every frame
+     * queued since the last write into one syscall. Bulk frames
+     * (specula::isBulk(), i.e. EXEC_OUT) go to the bulk lane; everything else
+     * is a control frame and overtakes queued bulk frames at the next frame
+     * boundary.
+     * The frame is encoded with the protocol currently selected by
+     * setProtocol(); @p requestId and @p flags only exist on the wire in v2.
      * @param cmd Command string.
-     * @param payload Payload string.
-     * @return true if send was successful, false otherwise.
+     * @param payload Payload string, moved into the queue when passed as an
+     * rvalue.
+     * @param requestId v2 request id (0 = none).
+     * @param flags v2 frame flags (e.g. specula::FLAG_BINARY).
+     * @return true if the frame was queued, false if the connection is down
+     * or the frame's lane is above the high-water mark.
+     */
+    bool send(std::string_view cmd, std::string payload,
+              uint32_t requestId = 0, uint8_t flags = 0);
+
+    /**
+     * @brief Selects the framing used for frames sent from now on.
+     *
+     * Incoming frames are accepted in either version at any time (v2 frames
+     * are recognised by their first byte), so each side switches its own
+     * output as soon as the negotiation in AUTH/OK allows it.
+     * @param version specula::PROTO_TEXT or specula::PROTO_BINARY.
+     */
+    void setProtocol(uint8_t version);
+
+    /**
+     * @brief Framing used for outgoing frames.
+     */
+    uint8_t protocol() const noexcept { return txVersion_.load(); }
+
+    /**
+     * @brief Byte counters of the frames eligible for compression, i.e. with
+     * a payload of at least the threshold passed to setCompression() (on
+     * receive: every compressed frame).
+     */
+    struct CompressionStats {
+        uint64_t framesOut = 0;  ///< Eligible frames sent.
+        uint64_t rawOut = 0;     ///< Their payload bytes before compression.
+        uint64_t wireOut = 0;    ///< Their payload bytes as sent.
+        uint64_t framesIn = 0;   ///< Compressed frames received.
+        uint64_t rawIn = 0;      ///< Their payload bytes after decompression.
+        uint64_t wireIn = 0;     ///< Their payload bytes as received.
+
+        /// raw / wire, 1 when nothing was compressed.
+        static double ratio(uint64_t raw, uint64_t wire) noexcept {
+            return wire ? static_cast<double>(raw) / static_cast<double>(wire)
+                        : 1.0;
+        }
+        double ratioOut() const noexcept { return ratio(rawOut, wireOut); }
+        double ratioIn() const noexcept { return ratio(rawIn, wireIn); }
+    };
+
+    /**
+     * @brief Enables compression of outgoing payloads of at least
+     * @p minBytes, once both sides agreed on it ("comp=lz" in AUTH / OK).
+     *
+     * Only applies to protocol v2 frames; a payload that does not shrink is
+     * sent as is. Compressed frames are always accepted on receive.
+     * @param enabled Whether to compress outgoing payloads.
+     * @param minBytes Smaller payloads (control frames) are never compressed.
+     */
+    void setCompression(bool enabled,
+                        size_t minBytes = specula::COMPRESS_MIN_BYTES);
+
+    /**
+     * @brief Whether outgoing payloads are being compressed.
+     */
+    bool compression() const noexcept { return compressTx_.load(); }
+
+    /**
+     * @brief Snapshot of the compression counters of this connection.
+     */
+    CompressionStats compressionStats() const noexcept;
+
+    /**
+     * @brief Queueing delay of control frames: time from send() until the
+     * frame was fully handed to the kernel.
+     */
+    struct ControlLatency {
+        uint64_t frames = 0;  ///< Control frames written.
+        uint64_t totalUs = 0;
+        uint64_t maxUs = 0;
+        double avgUs() const noexcept {
+            return frames ? static_cast<double>(totalUs) / frames : 0.0;
+        }
+    };
+
+    /**
+     * @brief Snapshot of the control-frame queueing delay of this connection.
+     */
+    ControlLatency controlLatency() const noexcept;
+
+    /**
+     * @brief Snapshot of this connection's transport metrics: bytes and
+     * frames in/out, frames per command, outbound queue depth and histograms
+     * of handler time and receive-to-dispatch delay.
+     *
+     * The counters are relaxed atomics updated on the I/O and worker
+     * threads; only the queue depth is read under the send lock.
+     */
+    TransportSnapshot metrics() const;
+
+    /**
+     * @brief Limits the bytes the kernel holds unsent for this socket
+     * (TCP_NOTSENT_LOWAT), which bounds how much bulk data a control frame
+     * can find ahead of it once written. Applied by start(); 0 keeps the
+     * system default.
+     * @param bytes Limit in bytes. Default is 128 KiB.
+     */
+    void setNotSentLowat(size_t bytes);
+
+    /**
+     * @brief Blocks until the bulk lane drops below half the high-water
+     * mark, for producers that prefer waiting to dropping frames.
+     * @param timeout Maximum time to wait.
+     * @return true if there is room, false on timeout or if the connection
+     * went down.
+     */
+    bool waitWritable(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Sets the per-lane outbound queue limit above which send() fails.
+     * @param bytes Limit in bytes. Default is 8 MiB.
      */
-    bool send(const std::string& cmd, const std::string& payload);
+    void setSendHighWater(size_t bytes);
 
     /**
-     * @brief Registers or updates a handler for a specific command.
-     * @param cmd Command string to handle.
-     * @param h Handler function.
+     * @brief Bytes queued for sending and not yet written to the socket.
      */
-    void on(const std::string& cmd, Handler h);
+    size_t pendingBytes() const;
 
     /**
-     * @brief Sets the default handler for unmapped commands.
-     * @param h Handler function.
+     * @brief Sets the table routing received frames to handlers, usually
+     * shared by every connection of the same role. Must be called before
+     * start(); frames arriving without a table are dropped.
      */
-    void setDefaultHandler(Handler h);
+    void setDispatchTable(std::shared_ptr<const DispatchTable> table);
+
+    /**
+     * @brief Sets the pool that runs this connection's handlers. Defaults to
+     * WorkerPool::shared(). Must be called before start().
+     */
+    void setWorkerPool(WorkerPool& pool);
 
     /**
      * @brief Sets the maximum allowed frame size for incoming messages.
@@ -87,42 +244,132 @@ class Connection {
      */
     void setReadChunk(size_t bytes);
 
+    /**
+     * @brief Sets a callback run once, on the I/O loop, when the peer closes
+     * the connection or it fails; stop() does not run it. Must be called
+     * before start(). The callback must not call stop().
+     */
+    void setOnClose(std::function<void()> fn);
+
     int getCfd() { return fd_; }
 
+    /// Id given by the owner (the controller's connection table), 0 if none.
+    int getId() const noexcept { return id_; }
+    void setId(int id) noexcept { id_ = id; }
+
     bool isAuthenticated{false};
 
    private:
     // states
     int fd_;
+    int id_ = 0;
+    std::function<void()> onClose_;
     std::atomic<bool> running_{false};
-    std::thread reader_;
-    std::string rxBuffer_;
+    EventLoop* loop_ = nullptr;
+    std::unique_ptr<EventLoop> ownLoop_;  // set by start() without a loop
+    RxBuffer rx_;
 
-    // sync
-    mutable std::mutex sendMx_;
-    std::mutex handlersMx_;
+    // outbound lanes: header, command, separator and payload of each frame
+    // are written as separate iovecs, so frames are never concatenated. v2
+    // frames with an opcode carry no command name at all.
+    struct OutFrame {
+        char hdr[24];
+        uint8_t hdrLen = 0;
+        bool withCmd = true;
+        std::string cmd;
+        std::string payload;
+        std::chrono::steady_clock::time_point queued;
+        size_t size() const noexcept {
+            return hdrLen + (withCmd ? cmd.size() + 1 : 0) + payload.size();
+        }
+    };
+    enum Lane : uint8_t { kControl = 0, kBulk = 1, kLanes = 2 };
+    std::atomic<uint8_t> txVersion_{1};
+    std::atomic<bool> compressTx_{false};
+    std::atomic<size_t> compressMin_{specula::COMPRESS_MIN_BYTES};
+    std::atomic<uint64_t> compFramesOut_{0}, compRawOut_{0}, compWireOut_{0};
+    std::atomic<uint64_t> compFramesIn_{0}, compRawIn_{0}, compWireIn_{0};
+    mutable std::mutex outMx_;
+    std::condition_variable outCv_;
+    std::deque<OutFrame> outq_[kLanes];
+    size_t laneBytes_[kLanes] = {};  // bytes of each lane not yet written
+    size_t headWritten_ = 0;     // bytes of outq_[headLane_].front() written
+    uint8_t headLane_ = kControl;  // lane of the partly written frame
+    std::atomic<uint64_t> ctrlFrames_{0}, ctrlDelayUs_{0}, ctrlDelayMaxUs_{0};
+    bool flushPosted_ = false;  // a flush task is queued on the loop
+    bool sendClosed_ = false;
 
     // dispatch
-    std::unordered_map<std::string, Handler> handlers_;
-    Handler defaultHandler_{};
+    struct Pending {
+        const Handler* handler;  // owned by table_
+        RxBuffer::SlabRef slab;  // keeps the frame's bytes alive
+        Frame frame;
+        Clock::time_point received;
+    };
+    TransportMetrics metrics_;
+    std::shared_ptr<const DispatchTable> table_;
+    WorkerPool* pool_;
+
+    // serial queue for Ordered handlers; at most one drain task is in flight.
+    // The drain task swaps strand_ with strandBatch_, so both keep their
+    // capacity and queuing a frame does not allocate in steady state.
+    std::mutex strandMx_;
+    std::vector<Pending> strand_;
+    std::vector<Pending> strandBatch_;
+    bool strandScheduled_ = false;
+
+    // handler tasks submitted and not yet finished, waited on by stop()
+    std::mutex inflightMx_;
+    std::condition_variable inflightCv_;
+    size_t inflight_ = 0;
+    std::atomic<bool> stopping_{false};
 
     // parameters
     size_t maxFrameSize_ = 16 * 1024 * 1024;  // 16 MiB
     size_t readChunk_ = 4096;
-    bool asyncDispatch_ = true;
+    size_t sendHighWater_ = 8 * 1024 * 1024;  // 8 MiB
+    size_t notSentLowat_ = 128 * 1024;        // 128 KiB
 
     // internals
-    void readLoop();
+    void onEvents(uint32_t events);
+    /**
+     * @brief Writes queued frames with sendmsg until both lanes are empty or
+     * the socket would block. Runs on the loop thread only.
+     *
+     * Each write carries, in order: the rest of a partly written frame, every
+     * queued control frame, then bulk frames up to a byte budget.
+     * @return false on a fatal socket error.
+     */
+    bool flushOut();
+    void closeFromLoop();
+    /**
+     * @brief Parses and dispatches every complete frame in rx_.
+     * @return false if the stream is malformed and the connection must close.
+     */
+    bool processFrames();
     /**
      * @brief Dispatches a payload to the appropriate handler based on the command.
      *
-     * This function extracts the command from the payload and looks up the corresponding
-     * handler in the handlers map. If a handler is found, it is executed asynchronously
-     * with the remaining payload.
+     * This function looks up the handler for the frame's command in the dispatch table.
+     * If a handler is found, it is queued on the worker pool with the frame, either on
+     * the connection's serial queue or independently depending on its Dispatch mode.
      *
-     * @param payload The payload containing the command and its arguments.
+     * @param slab Receive slab that @p frame points into.
+     * @param frame The parsed frame.
+     * @param received When the read that completed the frame returned.
+     */
+    void dispatch(const RxBuffer::SlabRef& slab, const Frame& frame,
+                  Clock::time_point received);
+    // runs a handler, recording its dispatch delay and execution time
+    void runHandler(const Handler& h, const Frame& frame,
+                    Clock::time_point received);
+    /**
+     * @brief Replaces a compressed frame's payload with its decompressed
+     * bytes, held (with the command) by a slab of their own.
+     * @return false if the payload is malformed or too large.
      */
-    void dispatch(const std::string& payload);
-    static bool writeAll(int fd, const void* buf, size_t n);
-    static bool readSome(int fd, void* buf, size_t n, ssize_t& outRead);
+    bool inflate(Frame& frame, RxBuffer::SlabRef& slab);
+    void drainStrand();
+    bool submitTask(std::function<void()> fn);
+    void waitHandlers();
 };
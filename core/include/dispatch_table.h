@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "framing.h"
+#include "protocol.h"
+
+class Connection;
+
+/**
+ * @brief Command handlers of one role (agent or controller), built once and
+ * shared by all its connections.
+ *
+ * Commands from protocol.h are stored in an array indexed by opcode, so a
+ * frame is routed with one index (v2 frames carry the opcode, v1 names are
+ * mapped by specula::opcodeOf()). Commands without an opcode fall back to a
+ * short list searched by name.
+ *
+ * The table is filled before any connection uses it and is immutable
+ * afterwards, so lookups take no lock. Handlers must not capture
+ * per-connection state: everything specific to a connection is reached
+ * through the Connection& they receive.
+ */
+class DispatchTable {
+   public:
+    /**
+     * @brief Handler type for processing received commands.
+     * @param conn Connection the frame arrived on.
+     * @param frame The frame received. Its views point into the receive
+     * buffer and are only valid for the duration of the call.
+     */
+    using Handler = std::function<void(Connection&, const Frame&)>;
+
+    /**
+     * @brief How frames of a command are scheduled on the worker pool.
+     *
+     * Ordered handlers run one at a time, in arrival order, on the
+     * connection's serial queue. Concurrent handlers are submitted to the pool
+     * independently, so a long-running one (e.g. EXEC) never delays the frames
+     * behind it.
+     */
+    enum class Mode { Ordered, Concurrent };
+
+    struct Route {
+        Handler handler;
+        Mode mode = Mode::Ordered;
+    };
+
+    /**
+     * @brief Registers or replaces the handler of a command.
+     * @param cmd Command name.
+     * @param h Handler function.
+     * @param mode Ordered (default) or Concurrent scheduling.
+     */
+    DispatchTable& on(std::string_view cmd, Handler h,
+                      Mode mode = Mode::Ordered);
+
+    /**
+     * @brief Sets the handler for commands without one of their own.
+     */
+    DispatchTable& setDefault(Handler h);
+
+    /**
+     * @brief Route of a frame, the default one if its command has none.
+     * @return nullptr if there is no handler at all.
+     */
+    const Route* find(const Frame& frame) const noexcept;
+
+   private:
+    Route byOpcode_[specula::OP_COUNT];
+    std::vector<std::pair<std::string, Route>> named_;  // OP_NAMED commands
+    Route default_;
+};
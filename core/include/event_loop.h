@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Single-threaded, edge-triggered epoll reactor.
+ *
+ * File descriptors registered with the loop must be non-blocking; their
+ * handlers run on the loop thread and are expected to drain the fd until
+ * EAGAIN (edge-triggered semantics).
+ */
+class EventLoop {
+   public:
+    /**
+     * @brief Handler invoked on the loop thread with the ready epoll events.
+     */
+    using IoHandler = std::function<void(uint32_t events)>;
+
+    /**
+     * @brief Task posted to run on the loop thread.
+     */
+    using Task = std::function<void()>;
+
+    EventLoop();
+
+    /**
+     * @brief Destructor. Stops the loop thread and closes the epoll fd.
+     */
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * @brief Spawns the loop thread.
+     * @return true if the loop is running, false if epoll setup failed.
+     */
+    bool start();
+
+    /**
+     * @brief Stops and joins the loop thread. Pending tasks are still run.
+     */
+    void stop();
+
+    /**
+     * @brief Checks if the loop thread is running.
+     */
+    bool isRunning() const noexcept;
+
+    /**
+     * @brief Checks if the caller is executing on the loop thread.
+     */
+    bool inLoopThread() const noexcept;
+
+    /**
+     * @brief Registers a non-blocking fd with the loop.
+     * @param fd File descriptor to watch. Ownership stays with the caller.
+     * @param events epoll event mask; EPOLLET is always added.
+     * @param h Handler called on the loop thread when the fd is ready.
+     * @return true on success, false otherwise.
+     */
+    bool add(int fd, uint32_t events, IoHandler h);
+
+    /**
+     * @brief Changes the event mask of an already registered fd.
+     * @return true on success, false otherwise.
+     */
+    bool modify(int fd, uint32_t events);
+
+    /**
+     * @brief Unregisters a fd.
+     *
+     * Synchronous: once this returns, the fd's handler is not running and will
+     * not be invoked again, and every task posted before the call has run, so
+     * the owner may safely close the fd or destroy whatever the handler and
+     * its tasks captured. Unknown fds still get the barrier.
+     */
+    void remove(int fd);
+
+    /**
+     * @brief Waits until every task posted before the call has run. No-op on
+     * the loop thread or when the loop is stopped.
+     */
+    void sync();
+
+    /**
+     * @brief Queues a task to run on the loop thread.
+     * @return false if the loop no longer accepts tasks (stopped).
+     */
+    bool post(Task t);
+
+   private:
+    struct Registration {
+        uint32_t gen;
+        std::shared_ptr<IoHandler> handler;
+    };
+
+    int epfd_{-1};
+    int wakefd_{-1};
+    std::thread thr_;
+    std::atomic<bool> running_{false};
+    std::atomic<std::thread::id> loopThreadId_{};
+
+    std::mutex regMx_;
+    std::unordered_map<int, Registration> regs_;
+    uint32_t nextGen_{1};
+
+    std::mutex tasksMx_;
+    std::vector<Task> tasks_;
+    bool acceptingTasks_{false};
+
+    void run_();
+    void wake_();
+    void drainTasks_();
+};
+
+/**
+ * @brief Fixed-size group of event loops with round-robin assignment.
+ */
+class EventLoopGroup {
+   public:
+    /**
+     * @brief Creates a group of @p n loops (at least one).
+     */
+    explicit EventLoopGroup(size_t n);
+    ~EventLoopGroup();
+
+    bool start();
+    void stop();
+
+    /**
+     * @brief Returns the next loop in round-robin order.
+     */
+    EventLoop& next();
+
+    /**
+     * @brief Returns the loop at index @p i.
+     */
+    EventLoop& at(size_t i) { return *loops_[i]; }
+
+    size_t size() const noexcept { return loops_.size(); }
+
+   private:
+    std::vector<std::unique_ptr<EventLoop>> loops_;
+    std::atomic<size_t> rr_{0};
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "protocol.h"
+
+/**
+ * @brief A received frame, parsed in place from the receive buffer.
+ *
+ * The views point into the receive slab and are only valid while the frame's
+ * handler runs.
+ */
+struct Frame {
+    std::string_view cmd;      ///< Command name (also set for v2 opcodes).
+    std::string_view payload;  ///< Bytes following the command.
+    uint16_t opcode = specula::OP_NAMED;
+    uint8_t flags = 0;
+    uint32_t requestId = 0;  ///< v2 request id, 0 for v1 frames.
+    uint8_t version = specula::PROTO_TEXT;
+
+    bool binary() const noexcept { return flags & specula::FLAG_BINARY; }
+};
+
+/**
+ * @brief Outcome of parsing one frame out of a byte range.
+ */
+enum class FrameParse { Ok, NeedMore, Bad };
+
+/**
+ * @brief Parses the frame at the start of @p in, v1 or v2 depending on its
+ * first byte.
+ *
+ * v1: "<LEN>\n<CMD>[\n| ]<payload>". v2: 12-byte header followed by the
+ * payload (prefixed by "<CMD>\n" for OP_NAMED).
+ * @param in Bytes available.
+ * @param maxFrame Largest acceptable frame body.
+ * @param out Set to the parsed frame on success; empty cmd means a frame
+ * without a command, to be ignored.
+ * @param consumed Set to the total frame size (header included) on success.
+ */
+FrameParse parseFrame(std::string_view in, size_t maxFrame, Frame& out,
+                      size_t& consumed) noexcept;
+
+/**
+ * @brief Writes a v1 "<LEN>\n" header into @p out (at least 21 bytes).
+ * @return Header length.
+ */
+size_t encodeTextHeader(char* out, size_t bodyLen) noexcept;
+
+/**
+ * @brief Writes a v2 header into @p out (at least V2_HEADER_SIZE bytes).
+ * @return Header length.
+ */
+size_t encodeBinaryHeader(char* out, uint16_t opcode, uint8_t flags,
+                          uint32_t bodyLen, uint32_t requestId) noexcept;
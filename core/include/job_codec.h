@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "framing.h"
+
+/**
+ * @brief One exec job in an EXEC_LIST reply.
+ */
+struct JobInfo {
+    uint32_t id = 0;         ///< Exec id from the EXEC frame.
+    bool running = false;    ///< false while waiting in the agent's queue.
+    uint32_t pid = 0;        ///< Process (group) id, 0 while queued.
+    uint64_t age_ms = 0;     ///< Time since it started, or was queued.
+    uint64_t bytes_out = 0;  ///< Output read so far, both streams.
+    std::string cmd;
+};
+
+/**
+ * @brief v1 text payload: one "<id> run|queue <pid> <age_ms> <bytes_out> <cmd>\n"
+ * line per job; newlines in the command are sent as spaces.
+ */
+std::string encodeJobsText(const std::vector<JobInfo>& jobs);
+
+/**
+ * @brief v2 binary payload (send with specula::FLAG_BINARY): varint count,
+ * then per job varint id, running, pid, age, bytes out and command length,
+ * and the command bytes.
+ */
+std::string encodeJobsBinary(const std::vector<JobInfo>& jobs);
+
+/**
+ * @brief Decodes an EXEC_LIST reply in either encoding.
+ * @return false if the payload is malformed.
+ */
+bool decodeJobs(const Frame& f, std::vector<JobInfo>& out);
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @file lz_codec.h
+ * @brief Small self-contained LZ77 block codec used for frame compression.
+ *
+ * The block format follows LZ4's: a sequence of (token, literals, offset,
+ * match) records where the token's high nibble is the literal length and
+ * the low nibble the match length minus 4, both extended with 255-valued
+ * bytes. Offsets are 16-bit little-endian, so the window is 64 KiB. The
+ * last sequence has literals only. It trades ratio for speed: a single
+ * hash probe per position and no entropy stage, which is enough for the
+ * repetitive text produced by logs and package listings.
+ */
+
+namespace lz {
+
+/**
+ * @brief Worst-case compressed size of @p n input bytes.
+ */
+inline constexpr size_t compressBound(size_t n) noexcept {
+    return n + n / 255 + 16;
+}
+
+/**
+ * @brief Compresses @p in into @p out (replacing its contents).
+ * @return false if the result is not smaller than the input, in which case
+ * the data should be sent as is.
+ */
+bool compress(std::string_view in, std::string& out);
+
+/**
+ * @brief Decompresses a block produced by compress().
+ * @param in Compressed block.
+ * @param out Destination of exactly @p outLen bytes.
+ * @param outLen Decompressed size, carried next to the block.
+ * @return false if the block is malformed or does not decode to exactly
+ * @p outLen bytes.
+ */
+bool decompress(std::string_view in, char* out, size_t outLen) noexcept;
+
+}  // namespace lz
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file metric_set.h
+ * @brief Variable-length host metrics as a sorted id/value array.
+ *
+ * A metric id packs a Kind (high 16 bits) and an instance (low 16 bits):
+ * the core number for per-core CPU, or an index into the set's label table
+ * (NIC, block device or mount point) for labelled kinds. Values are unsigned
+ * integers in fixed point (see KindInfo::scale), which keeps them exact on
+ * the wire and cheap to compare against telemetry thresholds.
+ */
+
+namespace metric {
+
+enum Kind : uint16_t {
+    CPU = 0,     ///< Aggregate CPU usage, hundredths of a percent.
+    MEM_USED,    ///< KiB.
+    MEM_TOTAL,   ///< KiB.
+    DISK_USED,   ///< KiB, root filesystem.
+    DISK_TOTAL,  ///< KiB, root filesystem.
+    LOAD1,       ///< Load average x100.
+    LOAD5,
+    LOAD15,
+    CORE_CPU,        ///< Per core (instance = core number), hundredths of a percent.
+    NET_RX_BYTES,    ///< Per NIC, bytes/s.
+    NET_TX_BYTES,
+    NET_RX_PACKETS,  ///< Per NIC, packets/s.
+    NET_TX_PACKETS,
+    BLK_READ_BYTES,  ///< Per block device, bytes/s.
+    BLK_WRITE_BYTES,
+    BLK_READ_OPS,    ///< Per block device, completed requests/s.
+    BLK_WRITE_OPS,
+    FS_USED,   ///< Per mounted filesystem (label = mount point), KiB.
+    FS_TOTAL,
+    CPU_MIN,  ///< Aggregate CPU over the reporting interval from high-rate
+    CPU_MAX,  ///< readings (cpu is their mean), hundredths of a percent.
+    CPU_P95,
+    KIND_COUNT
+};
+
+struct KindInfo {
+    const char* name;
+    uint32_t scale;     ///< Stored value = real value * scale.
+    bool labelled;      ///< Instance indexes the label table.
+    uint64_t minDelta;  ///< Telemetry: smallest change worth resending.
+    uint8_t relPct;     ///< Telemetry: ...and at least this % of the last value.
+};
+
+/// Properties of @p k; unknown kinds get a generic entry.
+const KindInfo& info(uint16_t k) noexcept;
+
+constexpr uint32_t makeId(Kind k, uint16_t instance = 0) noexcept {
+    return (static_cast<uint32_t>(k) << 16) | instance;
+}
+constexpr uint16_t kindOf(uint32_t id) noexcept {
+    return static_cast<uint16_t>(id >> 16);
+}
+constexpr uint16_t instanceOf(uint32_t id) noexcept {
+    return static_cast<uint16_t>(id & 0xffff);
+}
+
+}  // namespace metric
+
+/**
+ * @brief A host's metrics: entries sorted by id plus the instance labels.
+ */
+class MetricSet {
+   public:
+    struct Entry {
+        uint32_t id;
+        uint64_t value;
+    };
+
+    /// Empties the set, keeping its capacity.
+    void clear() noexcept {
+        entries_.clear();
+        labels_.clear();
+    }
+    bool empty() const noexcept { return entries_.empty(); }
+
+    /// Inserts or replaces; appending in id order is O(1).
+    void set(uint32_t id, uint64_t value);
+    bool get(uint32_t id, uint64_t& value) const noexcept;
+    uint64_t value(uint32_t id, uint64_t def = 0) const noexcept {
+        get(id, def);
+        return def;
+    }
+    /// Value divided by its kind's scale.
+    double real(uint32_t id) const noexcept;
+
+    /// Sum of every instance of @p k.
+    uint64_t sum(metric::Kind k) const noexcept;
+
+    /// Index of @p name in the label table, appending it if new.
+    uint16_t label(std::string_view name);
+    const std::vector<std::string>& labels() const noexcept { return labels_; }
+    /// "cpu", "core_cpu[3]", "net_rx_bytes[eth0]", ...
+    std::string nameOf(uint32_t id) const;
+
+    const std::vector<Entry>& entries() const noexcept { return entries_; }
+
+    /**
+     * @brief Binary form: varint label count, then (varint length, bytes)
+     * per label; varint entry count, then (varint id delta, varint value)
+     * per entry, ids ascending.
+     */
+    void encode(std::string& out) const;
+
+    /**
+     * @brief Parses encode()'s output from @p p, advancing it.
+     * @return false if malformed; the set is then unspecified.
+     */
+    bool decode(const char*& p, const char* end);
+
+   private:
+    std::vector<Entry> entries_;
+    std::vector<std::string> labels_;
+};
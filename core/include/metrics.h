@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "protocol.h"
+
+/**
+ * @file metrics.h
+ * @brief Lock-free transport counters and log-scale latency histograms.
+ *
+ * Writers only do relaxed atomic increments, so the counters can stay on in
+ * production; readers take a snapshot, which is not a consistent cut across
+ * counters but is exact for each one.
+ */
+
+/**
+ * @brief Plain copy of a LogHistogram.
+ *
+ * Bucket 0 counts values of 0 ns, bucket i > 0 values in [2^(i-1), 2^i) ns.
+ */
+struct HistogramSnapshot {
+    static constexpr size_t kBuckets = 40;  // last bucket: >= 2^38 ns (~4.6 min)
+    std::array<uint64_t, kBuckets> counts{};
+
+    uint64_t total() const noexcept;
+
+    /**
+     * @brief Upper bound (ns) of the bucket holding the @p q quantile.
+     * @param q Quantile in [0, 1].
+     * @return 0 if the histogram is empty.
+     */
+    uint64_t quantileNs(double q) const noexcept;
+
+    /// Lower bound (ns) of bucket @p i.
+    static uint64_t bucketFloorNs(size_t i) noexcept {
+        return i == 0 ? 0 : uint64_t{1} << (i - 1);
+    }
+
+    void merge(const HistogramSnapshot& o) noexcept;
+};
+
+/**
+ * @brief Fixed-bucket, power-of-two histogram of durations in nanoseconds.
+ */
+class LogHistogram {
+   public:
+    void record(uint64_t ns) noexcept {
+        size_t i = 0;
+        if (ns) i = 64 - static_cast<size_t>(__builtin_clzll(ns));
+        if (i >= HistogramSnapshot::kBuckets) i = HistogramSnapshot::kBuckets - 1;
+        counts_[i].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    HistogramSnapshot snapshot() const noexcept;
+
+   private:
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::kBuckets> counts_{};
+};
+
+/**
+ * @brief Plain copy of a connection's transport metrics, also used for
+ * aggregates across connections.
+ */
+struct TransportSnapshot {
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t framesIn = 0;
+    uint64_t framesOut = 0;
+    /// Frames per opcode; index specula::OP_NAMED counts commands without one.
+    std::array<uint64_t, specula::OP_COUNT> cmdIn{};
+    std::array<uint64_t, specula::OP_COUNT> cmdOut{};
+    uint64_t queuedFrames = 0;  ///< Outbound frames not yet written.
+    uint64_t queuedBytes = 0;   ///< Outbound bytes not yet written.
+    HistogramSnapshot handlerNs;   ///< Handler execution time.
+    HistogramSnapshot dispatchNs;  ///< Frame received -> handler started.
+
+    void merge(const TransportSnapshot& o) noexcept;
+};
+
+/**
+ * @brief Live transport counters of one connection.
+ */
+class TransportMetrics {
+   public:
+    void addIn(size_t bytes) noexcept {
+        bytesIn_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void addOut(size_t bytes) noexcept {
+        bytesOut_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void frameIn(uint16_t opcode) noexcept {
+        framesIn_.fetch_add(1, std::memory_order_relaxed);
+        cmdIn_[slot(opcode)].fetch_add(1, std::memory_order_relaxed);
+    }
+    void frameOut(uint16_t opcode) noexcept {
+        framesOut_.fetch_add(1, std::memory_order_relaxed);
+        cmdOut_[slot(opcode)].fetch_add(1, std::memory_order_relaxed);
+    }
+    void handler(uint64_t ns) noexcept { handlerNs_.record(ns); }
+    void dispatch(uint64_t ns) noexcept { dispatchNs_.record(ns); }
+
+    /**
+     * @brief Copies the counters; queue depth is left for the caller to fill.
+     */
+    TransportSnapshot snapshot() const noexcept;
+
+   private:
+    static size_t slot(uint16_t opcode) noexcept {
+        return opcode < specula::OP_COUNT ? opcode : size_t{specula::OP_NAMED};
+    }
+
+    std::atomic<uint64_t> bytesIn_{0}, bytesOut_{0};
+    std::atomic<uint64_t> framesIn_{0}, framesOut_{0};
+    std::array<std::atomic<uint64_t>, specula::OP_COUNT> cmdIn_{};
+    std::array<std::atomic<uint64_t>, specula::OP_COUNT> cmdOut_{};
+    LogHistogram handlerNs_;
+    LogHistogram dispatchNs_;
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 namespace specula {
@@ -6,9 +8,19 @@ namespace specula {
 
 inline constexpr std::string_view CMD_AUTH = "AUTH";
 inline constexpr std::string_view CMD_PING = "PING";
+inline constexpr std::string_view CMD_PONG = "PONG";
 inline constexpr std::string_view CMD_STATUS =
     "STATUS";
 inline constexpr std::string_view CMD_BYE = "BYE";
+inline constexpr std::string_view CMD_EXEC = "EXEC";
+inline constexpr std::string_view CMD_EXEC_OUT = "EXEC_OUT";
+inline constexpr std::string_view CMD_EXEC_DONE = "EXEC_DONE";
+inline constexpr std::string_view CMD_EXEC_CREDIT = "EXEC_CREDIT";
+inline constexpr std::string_view CMD_SUBSCRIBE = "SUBSCRIBE";
+inline constexpr std::string_view CMD_TELEMETRY = "TELEMETRY";
+inline constexpr std::string_view CMD_TOP = "TOP";
+inline constexpr std::string_view CMD_EXEC_KILL = "EXEC_KILL";
+inline constexpr std::string_view CMD_EXEC_LIST = "EXEC_LIST";
 
 
 inline constexpr std::string_view RESP_OK = "OK";
@@ -17,4 +29,209 @@ inline constexpr std::string_view RESP_ERR = "ERR";
 
 inline constexpr std::string_view NL = "\n";
 
+
+// ---------------------------------------------------------------------------
+// EXEC_OUT flow control. An EXEC carrying "window=<bytes>" lets the agent
+// stream that many output bytes; the controller returns credit with
+// "EXEC_CREDIT id=<id> bytes=<n>" as it consumes them, and the agent stops
+// reading the command's output while it has none left.
+// ---------------------------------------------------------------------------
+
+inline constexpr std::string_view EXEC_WINDOW_KEY = "window";
+inline constexpr size_t EXEC_WINDOW_BYTES = 256 * 1024;
+
+// ---------------------------------------------------------------------------
+// EXEC output streams. stderr chunks are tagged with FLAG_STDERR in v2 and
+// with "stream=err" after the id in v1; untagged chunks are stdout.
+// EXEC_DONE reports "id=<id> code=<status>", plus "signal=<n>" (and
+// code=128+n) when the command was killed by a signal.
+// ---------------------------------------------------------------------------
+
+inline constexpr std::string_view EXEC_STREAM_KEY = "stream";
+inline constexpr std::string_view EXEC_STREAM_ERR = "err";
+inline constexpr std::string_view EXEC_SIGNAL_KEY = "signal";
+
+// ---------------------------------------------------------------------------
+// Exec jobs. The agent runs a bounded number of EXECs at once and queues the
+// rest (refusing them once the queue is full). "timeout=<ms>" in an EXEC
+// kills the command's process group once it has run that long;
+// "EXEC_KILL id=<id>" kills it (or drops it from the queue) on demand.
+// EXEC_DONE then adds "reason=killed|timeout|busy". "EXEC_LIST" is answered
+// with an EXEC_LIST frame listing the jobs (see job_codec.h).
+// ---------------------------------------------------------------------------
+
+inline constexpr std::string_view EXEC_TIMEOUT_KEY = "timeout";
+inline constexpr std::string_view EXEC_REASON_KEY = "reason";
+inline constexpr std::string_view EXEC_REASON_KILLED = "killed";
+inline constexpr std::string_view EXEC_REASON_TIMEOUT = "timeout";
+inline constexpr std::string_view EXEC_REASON_BUSY = "busy";
+/// Timeout the controller's console puts on the commands it starts.
+inline constexpr uint32_t EXEC_DEFAULT_TIMEOUT_MS = 60 * 1000;
+
+// ---------------------------------------------------------------------------
+// EXEC_OUT coalescing. The agent batches a command's output and sends it
+// once "flush=<bytes>" have accumulated or the oldest byte is "delay=<ms>"
+// old, so line-by-line output does not become one frame per line.
+// delay=0 sends every read at once (interactive commands). Values above the
+// maxima are clamped.
+// ---------------------------------------------------------------------------
+
+inline constexpr std::string_view EXEC_FLUSH_KEY = "flush";
+inline constexpr std::string_view EXEC_DELAY_KEY = "delay";
+inline constexpr size_t EXEC_FLUSH_BYTES = 32 * 1024;
+inline constexpr uint32_t EXEC_FLUSH_DELAY_MS = 20;
+inline constexpr size_t EXEC_FLUSH_MAX_BYTES = 1024 * 1024;
+inline constexpr uint32_t EXEC_FLUSH_MAX_DELAY_MS = 1000;
+
+// ---------------------------------------------------------------------------
+// Telemetry push. "SUBSCRIBE interval=<ms> keyframe=<n>" makes the agent send
+// TELEMETRY frames on its own every interval (interval=0 unsubscribes); see
+// status_codec.h for the payload. Requires protocol v2.
+// ---------------------------------------------------------------------------
+
+inline constexpr std::string_view SUB_INTERVAL_KEY = "interval";
+inline constexpr std::string_view SUB_KEYFRAME_KEY = "keyframe";
+inline constexpr uint32_t TELEMETRY_INTERVAL_MS = 1000;
+inline constexpr uint32_t TELEMETRY_KEYFRAME_EVERY = 10;
+
+// ---------------------------------------------------------------------------
+// Process top. "TOP n=<count> by=cpu|mem" asks for the agent's busiest
+// processes; the agent answers with a TOP frame echoing the request id (see
+// top_codec.h for the payload).
+// ---------------------------------------------------------------------------
+
+inline constexpr std::string_view TOP_COUNT_KEY = "n";
+inline constexpr std::string_view TOP_BY_KEY = "by";
+inline constexpr uint32_t TOP_DEFAULT_COUNT = 10;
+inline constexpr uint32_t TOP_MAX_COUNT = 100;
+
+// ---------------------------------------------------------------------------
+// Protocol v2 (binary framing), negotiated with "proto=2" in AUTH / OK.
+//
+// Every v2 frame starts with a fixed 12-byte little-endian header:
+//   u8  magic (0xB2, never a decimal digit, so v1 and v2 frames can be told
+//       apart by their first byte)
+//   u8  flags
+//   u16 opcode
+//   u32 payload length
+//   u32 request id (0 = none)
+// OP_NAMED carries commands without an opcode as "<CMD>\n<payload>".
+// ---------------------------------------------------------------------------
+
+inline constexpr uint8_t PROTO_TEXT = 1;
+inline constexpr uint8_t PROTO_BINARY = 2;
+inline constexpr std::string_view PROTO_KEY = "proto";
+
+inline constexpr uint8_t V2_MAGIC = 0xB2;
+inline constexpr size_t V2_HEADER_SIZE = 12;
+
+/// Payload uses the command's binary layout instead of text.
+inline constexpr uint8_t FLAG_BINARY = 0x01;
+/// Payload is "u32 raw length" + an lz block (see lz_codec.h). Only sent once
+/// "comp=lz" was negotiated in AUTH / OK.
+inline constexpr uint8_t FLAG_COMPRESSED = 0x02;
+/// EXEC_OUT: the chunk was read from the command's stderr (stdout if clear).
+inline constexpr uint8_t FLAG_STDERR = 0x04;
+
+inline constexpr std::string_view COMP_KEY = "comp";
+inline constexpr std::string_view COMP_LZ = "lz";
+/// Payloads smaller than this are never compressed.
+inline constexpr size_t COMPRESS_MIN_BYTES = 512;
+
+enum Opcode : uint16_t {
+    OP_NAMED = 0,
+    OP_AUTH,
+    OP_PING,
+    OP_PONG,
+    OP_STATUS,
+    OP_BYE,
+    OP_OK,
+    OP_ERR,
+    OP_EXEC,
+    OP_EXEC_OUT,
+    OP_EXEC_DONE,
+    OP_EXEC_CREDIT,
+    OP_SUBSCRIBE,
+    OP_TELEMETRY,
+    OP_TOP,
+    OP_EXEC_KILL,
+    OP_EXEC_LIST,
+    OP_COUNT
+};
+
+inline constexpr std::string_view OPCODE_NAMES[OP_COUNT] = {
+    "",       CMD_AUTH, CMD_PING,  CMD_PONG,     CMD_STATUS,   CMD_BYE,
+    RESP_OK,  RESP_ERR, CMD_EXEC,  CMD_EXEC_OUT, CMD_EXEC_DONE,
+    CMD_EXEC_CREDIT, CMD_SUBSCRIBE, CMD_TELEMETRY,
+    CMD_TOP,  CMD_EXEC_KILL, CMD_EXEC_LIST};
+
+/**
+ * @brief Opcode of a command name, OP_NAMED if it has none.
+ *
+ * A switch on the length and a distinguishing character selects the single
+ * candidate, which is then compared once, so lookups cost one string compare
+ * whatever the number of commands.
+ */
+constexpr uint16_t opcodeOf(std::string_view cmd) noexcept {
+    auto is = [&](uint16_t op) noexcept {
+        return cmd == OPCODE_NAMES[op] ? op : uint16_t{OP_NAMED};
+    };
+    switch (cmd.size()) {
+        case 2:
+            return is(OP_OK);
+        case 3:
+            switch (cmd[0]) {
+                case 'B': return is(OP_BYE);
+                case 'E': return is(OP_ERR);
+                case 'T': return is(OP_TOP);
+                default: return OP_NAMED;
+            }
+        case 4:
+            switch (cmd[1]) {
+                case 'U': return is(OP_AUTH);
+                case 'I': return is(OP_PING);
+                case 'O': return is(OP_PONG);
+                case 'X': return is(OP_EXEC);
+                default: return OP_NAMED;
+            }
+        case 6:
+            return is(OP_STATUS);
+        case 8:
+            return is(OP_EXEC_OUT);
+        case 9:
+            switch (cmd[5]) {
+                case 'D': return is(OP_EXEC_DONE);
+                case 'K': return is(OP_EXEC_KILL);
+                case 'L': return is(OP_EXEC_LIST);
+                case 'R': return is(OP_SUBSCRIBE);
+                case 'E': return is(OP_TELEMETRY);
+                default: return OP_NAMED;
+            }
+        case 11:
+            return is(OP_EXEC_CREDIT);
+        default:
+            return OP_NAMED;
+    }
+}
+
+// every named opcode must round-trip through the switch above
+constexpr bool opcodeTableConsistent() noexcept {
+    for (uint16_t op = 1; op < OP_COUNT; ++op)
+        if (opcodeOf(OPCODE_NAMES[op]) != op) return false;
+    return true;
+}
+static_assert(opcodeTableConsistent(),
+              "opcodeOf() is out of sync with OPCODE_NAMES");
+
+/// Bulk frames (streamed command output, and EXEC_DONE, which must not
+/// overtake it) queue behind every control frame.
+constexpr bool isBulk(uint16_t op) noexcept {
+    return op == OP_EXEC_OUT || op == OP_EXEC_DONE;
+}
+
+/// Command name of an opcode, empty for OP_NAMED or unknown values.
+constexpr std::string_view commandOf(uint16_t op) noexcept {
+    return op < OP_COUNT ? OPCODE_NAMES[op] : std::string_view{};
+}
+
 }
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Receive buffer made of reusable, reference-counted slabs.
+ *
+ * Socket reads land directly in the current slab and frames are parsed in
+ * place. A parsed frame is handed out as a string_view plus a SlabRef that
+ * keeps the underlying memory alive until its handler finishes. Once every
+ * reference to a slab is dropped it is recycled, so steady-state traffic
+ * performs no allocation and only the trailing partial frame is ever moved.
+ */
+class RxBuffer {
+   public:
+    struct Slab {
+        std::unique_ptr<char[]> data;
+        size_t cap = 0;
+    };
+    using SlabRef = std::shared_ptr<const Slab>;
+
+    /**
+     * @brief Creates the buffer with a first slab of @p slabSize bytes.
+     */
+    explicit RxBuffer(size_t slabSize = 64 * 1024);
+
+    /**
+     * @brief Makes room for at least @p n contiguous writable bytes.
+     *
+     * Unconsumed bytes are compacted to the front of the current slab when
+     * nothing else references it, or moved into a recycled/new slab otherwise.
+     */
+    void reserve(size_t n);
+
+    char* writePtr() noexcept { return cur_->data.get() + end_; }
+    size_t writable() const noexcept { return cur_->cap - end_; }
+
+    /**
+     * @brief Marks @p n bytes written at writePtr() as readable.
+     */
+    void commit(size_t n) noexcept { end_ += n; }
+
+    std::string_view readable() const noexcept {
+        return {cur_->data.get() + begin_, end_ - begin_};
+    }
+
+    /**
+     * @brief Drops @p n bytes from the front of the readable region.
+     */
+    void consume(size_t n) noexcept;
+
+    /**
+     * @brief Reference to the slab currently backing readable().
+     */
+    SlabRef slab() const { return cur_; }
+
+   private:
+    std::shared_ptr<Slab> cur_;
+    std::vector<std::shared_ptr<Slab>> retired_;  // slabs still referenced by frames
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    size_t slabSize_;
+
+    std::shared_ptr<Slab> acquire_(size_t minCap);
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "framing.h"
+#include "metric_set.h"
+
+/**
+ * @brief v1 text payload: "cpu=<pct>% mem=<used>/<total> disk=<used>/<total>\n".
+ * Only these base metrics fit the text form.
+ */
+std::string encodeStatusText(const MetricSet& m);
+
+/**
+ * @brief v2 binary payload (send with specula::FLAG_BINARY): the full
+ * metric set, as MetricSet::encode().
+ */
+std::string encodeStatusBinary(const MetricSet& m);
+
+/**
+ * @brief Decodes a STATUS frame in either encoding into @p out.
+ * @return false if the payload is malformed.
+ */
+bool decodeStatus(const Frame& f, MetricSet& out);
+
+// ---------------------------------------------------------------------------
+// TELEMETRY push payload (always binary): u8 flags (TELEMETRY_KEYFRAME), then
+//   keyframe: the full set, as MetricSet::encode()
+//   delta:    varint count, then (varint id delta, varint value) per entry
+// A delta carries only metrics that moved past their kind's threshold since
+// they were last sent (or are new), as absolute values, so a receiver never
+// accumulates error. Label changes and vanished instances wait for a
+// keyframe: the encoder forces one when the label table changes.
+// ---------------------------------------------------------------------------
+
+inline constexpr uint8_t TELEMETRY_KEYFRAME = 0x01;
+
+/**
+ * @brief Agent-side state of a telemetry subscription: remembers what was
+ * last sent for each metric and when the next keyframe is due.
+ */
+class TelemetryEncoder {
+   public:
+    /**
+     * @param keyframeEvery Send a full keyframe every this many frames
+     * (0 or 1: every frame is a keyframe).
+     */
+    explicit TelemetryEncoder(uint32_t keyframeEvery) noexcept
+        : keyframeEvery_(keyframeEvery) {}
+
+    /**
+     * @brief Encodes @p m into @p out.
+     * @return false (and @p out untouched) if no metric moved past its
+     * threshold and no keyframe is due, i.e. there is nothing to send.
+     */
+    bool encode(const MetricSet& m, std::string& out);
+
+    /// Makes the next encode() a keyframe.
+    void reset() noexcept { sinceKeyframe_ = 0; }
+
+   private:
+    uint32_t keyframeEvery_;
+    uint32_t sinceKeyframe_ = 0;  // 0: next frame is a keyframe
+    MetricSet sent_;              // last value sent per metric
+    std::vector<MetricSet::Entry> changed_;
+};
+
+/**
+ * @brief Applies a TELEMETRY payload on top of @p state (a keyframe
+ * replaces it).
+ * @param keyframe Set to whether the payload was a keyframe.
+ * @return false if the payload is malformed; @p state is then unchanged.
+ */
+bool applyTelemetry(std::string_view payload, MetricSet& state, bool& keyframe);
@@ -29,9 +29,9 @@ class TcpListener : public TcpSocket {
         if (::inet_pton(AF_INET, bindAddr.c_str(), &addr.sin_addr) <= 0)
             addr.sin_addr.s_addr = INADDR_ANY;
 
-        // Bind the socket to the address and start listening with a backlog of 16 connections
+        // Bind the socket to the address and start listening with the system's maximum backlog
         if (::bind(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) return false;
-        if (::listen(fd_, 16) != 0) return false;
+        if (::listen(fd_, SOMAXCONN) != 0) return false;
         return true;  // Successfully opened the listener
     }
 
@@ -43,4 +43,14 @@ class TcpListener : public TcpSocket {
         // Return a TcpSocket object for the accepted connection
         return TcpSocket(cfd);
     }
+
+    // tryAccept method accepts a pending connection without blocking (the listener must be
+    // non-blocking). Returns the new fd, or -1 when nothing is pending (errno == EAGAIN) or on error.
+    int tryAccept(int flags = SOCK_NONBLOCK | SOCK_CLOEXEC) const noexcept {
+        while (true) {
+            int cfd = ::accept4(fd_, nullptr, nullptr, flags);
+            if (cfd < 0 && errno == EINTR) continue;  // Retry if interrupted
+            return cfd;
+        }
+    }
 };
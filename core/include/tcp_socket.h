@@ -1,8 +1,10 @@
 #pragma once
+#include <fcntl.h>
 #include <netdb.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
@@ -36,6 +38,14 @@ class TcpSocket {
     // fd() returns the file descriptor of the socket.
     int fd() const noexcept { return fd_; }
 
+    // setNonBlocking() toggles O_NONBLOCK on the socket.
+    bool setNonBlocking(bool on = true) const noexcept {
+        int flags = ::fcntl(fd_, F_GETFL, 0);
+        if (flags < 0) return false;
+        flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        return ::fcntl(fd_, F_SETFL, flags) == 0;
+    }
+
     // close() shuts down and closes the socket.
     void close() noexcept {
         if (fd_ >= 0) {
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "framing.h"
+
+/**
+ * @brief One process in a TOP reply.
+ */
+struct ProcInfo {
+    uint32_t pid = 0;
+    uint32_t cpu_centi = 0;  ///< CPU usage since the previous scan, hundredths of a percent of one core.
+    uint64_t rss_kb = 0;
+    std::string name;        ///< Command name (comm), at most 15 characters.
+};
+
+/**
+ * @brief v1 text payload: one "<pid> <cpu>% <rss_kb> <name>\n" line per process.
+ */
+std::string encodeTopText(const std::vector<ProcInfo>& procs);
+
+/**
+ * @brief v2 binary payload (send with specula::FLAG_BINARY): varint count,
+ * then per process varint pid, cpu, rss and name length, and the name bytes.
+ */
+std::string encodeTopBinary(const std::vector<ProcInfo>& procs);
+
+/**
+ * @brief Decodes a TOP reply in either encoding.
+ * @return false if the payload is malformed.
+ */
+bool decodeTop(const Frame& f, std::vector<ProcInfo>& out);
@@ -3,9 +3,11 @@
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 std::string trim(std::string x);
-std::unordered_map<std::string, std::string> parse_kv(const std::string& s);
+std::unordered_map<std::string, std::string> parse_kv(std::string_view s);
 std::string humanBytes(uint64_t b);
+std::string humanDuration(uint64_t ns);
 double pct(uint64_t used, uint64_t total);
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @file wire.h
+ * @brief Little-endian encode/decode helpers for binary payloads.
+ */
+
+namespace wire {
+
+inline void putU16(char* p, uint16_t v) noexcept {
+    p[0] = static_cast<char>(v);
+    p[1] = static_cast<char>(v >> 8);
+}
+
+inline void putU32(char* p, uint32_t v) noexcept {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<char>(v >> (8 * i));
+}
+
+inline void putU64(char* p, uint64_t v) noexcept {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<char>(v >> (8 * i));
+}
+
+inline uint16_t getU16(const char* p) noexcept {
+    const auto* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>(u[0] | (u[1] << 8));
+}
+
+inline uint32_t getU32(const char* p) noexcept {
+    const auto* u = reinterpret_cast<const unsigned char*>(p);
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | u[i];
+    return v;
+}
+
+inline uint64_t getU64(const char* p) noexcept {
+    const auto* u = reinterpret_cast<const unsigned char*>(p);
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | u[i];
+    return v;
+}
+
+inline void putF32(char* p, float f) noexcept {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    putU32(p, bits);
+}
+
+inline float getF32(const char* p) noexcept {
+    uint32_t bits = getU32(p);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// appenders for building payloads in a std::string
+inline void appendU16(std::string& s, uint16_t v) {
+    char b[2];
+    putU16(b, v);
+    s.append(b, 2);
+}
+
+inline void appendU32(std::string& s, uint32_t v) {
+    char b[4];
+    putU32(b, v);
+    s.append(b, 4);
+}
+
+inline void appendU64(std::string& s, uint64_t v) {
+    char b[8];
+    putU64(b, v);
+    s.append(b, 8);
+}
+
+inline void appendF32(std::string& s, float f) {
+    char b[4];
+    putF32(b, f);
+    s.append(b, 4);
+}
+
+// LEB128 varints: 7 bits per byte, high bit set on all but the last
+inline void appendVarU64(std::string& s, uint64_t v) {
+    while (v >= 0x80) {
+        s.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    s.push_back(static_cast<char>(v));
+}
+
+/// Decodes a varint at @p p, advancing it; false if truncated or too long.
+inline bool getVarU64(const char*& p, const char* end, uint64_t& v) noexcept {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const auto b = static_cast<unsigned char>(*p++);
+        x |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            v = x;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace wire
@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed-size thread pool with a bounded task queue.
+ *
+ * Used by Connection to run command handlers without creating a thread per
+ * frame. When the queue is full, submit() blocks the producer (normally an
+ * I/O thread), which propagates backpressure to the socket.
+ */
+class WorkerPool {
+   public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Creates the pool and spawns its workers.
+     * @param threads Number of workers; 0 picks max(4, hardware threads).
+     * @param maxQueue Maximum number of queued (not yet running) tasks.
+     */
+    explicit WorkerPool(size_t threads = 0, size_t maxQueue = 64 * 1024);
+
+    /**
+     * @brief Destructor. Runs the remaining queued tasks and joins workers.
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Queues a task, blocking while the queue is full.
+     * @return false if the pool has been stopped.
+     */
+    bool submit(Task t);
+
+    /**
+     * @brief Stops accepting tasks, drains the queue and joins the workers.
+     */
+    void stop();
+
+    size_t threads() const noexcept { return workers_.size(); }
+
+    /**
+     * @brief Process-wide pool shared by every Connection by default.
+     */
+    static WorkerPool& shared();
+
+   private:
+    std::vector<std::thread> workers_;
+    std::deque<Task> queue_;
+    size_t maxQueue_;
+    bool stopping_{false};
+
+    std::mutex mx_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+
+    void workerLoop_();
+};
@@ -1,37 +1,95 @@
 #include "../include/connection.h"
 
-#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <cerrno>
-#include <future>
+#include <cstring>
 #include <iostream>
-#include <sstream>
-#include <vector>
 
-Connection::Connection(int fd) : fd_(fd) {}
+#include "../include/event_loop.h"
+#include "../include/lz_codec.h"
+#include "../include/wire.h"
+#include "../include/worker_pool.h"
+
+namespace {
+// connection whose handler the current worker thread is running, so stop()
+// called from inside a handler does not wait for itself
+thread_local const Connection* tl_current = nullptr;
+
+constexpr uint32_t kIoEvents = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+constexpr size_t kMaxFramesPerWrite = 64;  // 4 iovecs each, well below IOV_MAX
+// bulk bytes added to one sendmsg, so a control frame queued meanwhile waits
+// for at most one bounded write
+constexpr size_t kMaxBulkPerWrite = 256 * 1024;
+const char kCmdSep = '\n';
+}  // namespace
+
+Connection::Connection(int fd) : fd_(fd), pool_(&WorkerPool::shared()) {}
 Connection::~Connection() { stop(); }
 
 void Connection::start() {
+    if (running_.load()) return;  // already running
+    ownLoop_ = std::make_unique<EventLoop>();
+    if (!ownLoop_->start()) {
+        ownLoop_.reset();
+        return;
+    }
+    start(*ownLoop_);
+}
+
+void Connection::start(EventLoop& loop) {
     if (running_.exchange(true)) return;  // already running
-    reader_ = std::thread([this] { readLoop(); });
+    int flags = ::fcntl(fd_, F_GETFL, 0);
+    if (flags >= 0) ::fcntl(fd_, F_SETFL, flags | O_NONBLOCK);
+    if (notSentLowat_) {
+        // keep the kernel's unsent backlog short: bulk data waits in our
+        // lanes, where control frames can still overtake it
+        int lowat = static_cast<int>(notSentLowat_);
+        ::setsockopt(fd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat,
+                     sizeof(lowat));
+    }
+    loop_ = &loop;
+    // EPOLLOUT is edge-triggered too, so it only fires when a full socket
+    // buffer drains, i.e. exactly when a stalled flush can resume
+    if (!loop.add(fd_, kIoEvents, [this](uint32_t ev) { onEvents(ev); })) {
+        loop_ = nullptr;
+        running_ = false;
+    }
 }
 
 void Connection::stop() {
+    stopping_.store(true);
     running_.store(false, std::memory_order_relaxed);
-    if (fd_ >= 0) {
-        ::shutdown(fd_, SHUT_RDWR);
+
+    // handlers already running may still queue replies
+    waitHandlers();
+
+    {
+        std::lock_guard<std::mutex> lk(outMx_);
+        sendClosed_ = true;
     }
-    if (reader_.joinable()) {
-        if (std::this_thread::get_id() == reader_.get_id()) {
-            reader_.detach();
-        } else {
-            reader_.join();
-        }
+    outCv_.notify_all();
+
+    if (loop_) {
+        // best-effort final flush, then unregister; remove() is a barrier for
+        // this task and every flush posted by send() before sendClosed_
+        if (fd_ >= 0) loop_->post([this] { flushOut(); });
+        loop_->remove(fd_);
+        loop_ = nullptr;
+    }
+    if (ownLoop_) {
+        ownLoop_->stop();
+        ownLoop_.reset();
     }
 
     if (fd_ >= 0) {
+        ::shutdown(fd_, SHUT_RDWR);
         ::close(fd_);
         fd_ = -1;
     }
@@ -39,138 +97,418 @@ void Connection::stop() {
 
 bool Connection::isRunning() const noexcept { return running_.load(); }
 
-bool Connection::writeAll(int fd, const void* buf, size_t n) {
-    const char* p = static_cast<const char*>(buf);
-    while (n) {
-        ssize_t w = ::send(fd, p, n, 0);
+bool Connection::send(std::string_view cmd, std::string payload,
+                      uint32_t requestId, uint8_t flags) {
+    OutFrame f;
+    f.payload = std::move(payload);
+
+    // compressed outside outMx_; the raw payload is kept in case the
+    // protocol is still v1 once the lock is held
+    std::string packed;
+    const bool eligible = compressTx_.load() &&
+                          txVersion_.load() >= specula::PROTO_BINARY &&
+                          f.payload.size() >= compressMin_.load() &&
+                          f.payload.size() <= UINT32_MAX;
+    bool compressed = false;
+    if (eligible) {
+        std::string block;
+        if (lz::compress(f.payload, block)) {
+            packed.reserve(4 + block.size());
+            wire::appendU32(packed, static_cast<uint32_t>(f.payload.size()));
+            packed.append(block);
+            compressed = packed.size() < f.payload.size();
+        }
+    }
+
+    std::lock_guard<std::mutex> lk(outMx_);
+    if (sendClosed_ || !running_.load() || !loop_) return false;
+
+    if (eligible && txVersion_.load() >= specula::PROTO_BINARY) {
+        compFramesOut_.fetch_add(1, std::memory_order_relaxed);
+        compRawOut_.fetch_add(f.payload.size(), std::memory_order_relaxed);
+        if (compressed) {
+            f.payload.swap(packed);
+            flags |= specula::FLAG_COMPRESSED;
+        }
+        compWireOut_.fetch_add(f.payload.size(), std::memory_order_relaxed);
+    }
+
+    // encoded under outMx_ so a protocol switch orders with queued frames
+    const uint16_t op = specula::opcodeOf(cmd);
+    if (txVersion_.load() >= specula::PROTO_BINARY) {
+        f.withCmd = (op == specula::OP_NAMED);
+        if (f.withCmd) f.cmd.assign(cmd.data(), cmd.size());
+        const size_t body = f.size();  // hdrLen is still 0 here
+        f.hdrLen = static_cast<uint8_t>(encodeBinaryHeader(
+            f.hdr, op, flags, static_cast<uint32_t>(body), requestId));
+    } else {
+        f.cmd.assign(cmd.data(), cmd.size());
+        f.hdrLen = static_cast<uint8_t>(encodeTextHeader(f.hdr, f.size()));
+    }
+
+    // a single frame larger than the mark still goes out on an empty lane
+    const uint8_t lane = specula::isBulk(op) ? kBulk : kControl;
+    if (!outq_[lane].empty() && laneBytes_[lane] + f.size() > sendHighWater_)
+        return false;
+
+    f.queued = std::chrono::steady_clock::now();
+    laneBytes_[lane] += f.size();
+    outq_[lane].push_back(std::move(f));
+    metrics_.frameOut(op);
+    if (!flushPosted_) {
+        // posted under outMx_ so stop() cannot slip its barrier in between
+        flushPosted_ = loop_->post([this] { flushOut(); });
+    }
+    return true;
+}
+
+bool Connection::waitWritable(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lk(outMx_);
+    auto up = [&] { return !sendClosed_ && running_.load(); };
+    outCv_.wait_for(lk, timeout, [&] {
+        return !up() || laneBytes_[kBulk] <= sendHighWater_ / 2;
+    });
+    return up() && laneBytes_[kBulk] <= sendHighWater_ / 2;
+}
+
+void Connection::setProtocol(uint8_t version) {
+    std::lock_guard<std::mutex> lk(outMx_);
+    txVersion_ = version;
+}
+
+void Connection::setCompression(bool enabled, size_t minBytes) {
+    compressMin_ = minBytes ? minBytes : 1;
+    compressTx_ = enabled;
+}
+
+Connection::CompressionStats Connection::compressionStats() const noexcept {
+    CompressionStats s;
+    s.framesOut = compFramesOut_.load(std::memory_order_relaxed);
+    s.rawOut = compRawOut_.load(std::memory_order_relaxed);
+    s.wireOut = compWireOut_.load(std::memory_order_relaxed);
+    s.framesIn = compFramesIn_.load(std::memory_order_relaxed);
+    s.rawIn = compRawIn_.load(std::memory_order_relaxed);
+    s.wireIn = compWireIn_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void Connection::setSendHighWater(size_t bytes) {
+    std::lock_guard<std::mutex> lk(outMx_);
+    sendHighWater_ = bytes ? bytes : 1;
+}
+
+size_t Connection::pendingBytes() const {
+    std::lock_guard<std::mutex> lk(outMx_);
+    return laneBytes_[kControl] + laneBytes_[kBulk];
+}
+
+void Connection::setNotSentLowat(size_t bytes) { notSentLowat_ = bytes; }
+
+TransportSnapshot Connection::metrics() const {
+    TransportSnapshot s = metrics_.snapshot();
+    std::lock_guard<std::mutex> lk(outMx_);
+    s.queuedFrames = outq_[kControl].size() + outq_[kBulk].size();
+    s.queuedBytes = laneBytes_[kControl] + laneBytes_[kBulk];
+    return s;
+}
+
+Connection::ControlLatency Connection::controlLatency() const noexcept {
+    ControlLatency l;
+    l.frames = ctrlFrames_.load(std::memory_order_relaxed);
+    l.totalUs = ctrlDelayUs_.load(std::memory_order_relaxed);
+    l.maxUs = ctrlDelayMaxUs_.load(std::memory_order_relaxed);
+    return l;
+}
+
+bool Connection::flushOut() {
+    iovec iov[kMaxFramesPerWrite * 4];
+    uint8_t order[kMaxFramesPerWrite];  // lane of each frame in iov
+    {
+        std::lock_guard<std::mutex> lk(outMx_);
+        flushPosted_ = false;
+    }
+
+    while (true) {
+        size_t n = 0;
+        size_t frames = 0;
+        {
+            // only the loop thread pops, and deque::push_back keeps element
+            // references valid, so the iovecs stay valid after unlocking
+            std::lock_guard<std::mutex> lk(outMx_);
+            if (outq_[kControl].empty() && outq_[kBulk].empty()) return true;
+            size_t skip = headWritten_;
+            auto add = [&](const char* p, size_t len) {
+                if (skip >= len) {
+                    skip -= len;
+                    return;
+                }
+                iov[n].iov_base = const_cast<char*>(p + skip);
+                iov[n].iov_len = len - skip;
+                ++n;
+                skip = 0;
+            };
+            auto addFrame = [&](uint8_t lane, const OutFrame& f) {
+                add(f.hdr, f.hdrLen);
+                if (f.withCmd) {
+                    add(f.cmd.data(), f.cmd.size());
+                    add(&kCmdSep, 1);
+                }
+                add(f.payload.data(), f.payload.size());
+                order[frames++] = lane;
+            };
+
+            // frames are never interleaved: a partly written one goes first,
+            // then control frames overtake whatever bulk is queued
+            size_t from[kLanes] = {0, 0};
+            if (headWritten_) {
+                addFrame(headLane_, outq_[headLane_].front());
+                from[headLane_] = 1;
+            }
+            const auto& ctrl = outq_[kControl];
+            for (size_t i = from[kControl];
+                 i < ctrl.size() && frames < kMaxFramesPerWrite; ++i)
+                addFrame(kControl, ctrl[i]);
+            const auto& bulk = outq_[kBulk];
+            size_t bulkBytes = 0;
+            for (size_t i = from[kBulk]; i < bulk.size() &&
+                                         frames < kMaxFramesPerWrite &&
+                                         bulkBytes < kMaxBulkPerWrite;
+                 ++i) {
+                addFrame(kBulk, bulk[i]);
+                bulkBytes += bulk[i].size();
+            }
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        ssize_t w = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
         if (w < 0) {
             if (errno == EINTR) continue;
+            // socket full: the EPOLLOUT edge resumes the flush
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
             return false;
         }
-        p += w;
-        n -= static_cast<size_t>(w);
+
+        const auto now = std::chrono::steady_clock::now();
+        metrics_.addOut(static_cast<size_t>(w));
+        std::lock_guard<std::mutex> lk(outMx_);
+        size_t left = static_cast<size_t>(w);
+        for (size_t k = 0; left; ++k) {
+            const uint8_t lane = order[k];
+            auto& q = outq_[lane];
+            const size_t rem = q.front().size() - headWritten_;
+            if (left < rem) {
+                headWritten_ += left;
+                headLane_ = lane;
+                laneBytes_[lane] -= left;
+                break;
+            }
+            left -= rem;
+            laneBytes_[lane] -= rem;
+            headWritten_ = 0;
+            if (lane == kControl) {
+                const uint64_t us = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        now - q.front().queued)
+                        .count());
+                ctrlFrames_.fetch_add(1, std::memory_order_relaxed);
+                ctrlDelayUs_.fetch_add(us, std::memory_order_relaxed);
+                if (us > ctrlDelayMaxUs_.load(std::memory_order_relaxed))
+                    ctrlDelayMaxUs_.store(us, std::memory_order_relaxed);
+            }
+            q.pop_front();
+        }
+        if (laneBytes_[kBulk] <= sendHighWater_ / 2) outCv_.notify_all();
     }
-    return true;
 }
 
-bool Connection::readSome(int fd, void* buf, size_t n, ssize_t& outRead) {
-    outRead = ::recv(fd, buf, n, 0);
-    if (outRead < 0 && errno == EINTR) {
-        outRead = 0;
-        return true;
+void Connection::closeFromLoop() {
+    running_ = false;
+    loop_->remove(fd_);
+    ::shutdown(fd_, SHUT_RDWR);
+    {
+        std::lock_guard<std::mutex> lk(outMx_);
+        outCv_.notify_all();
     }
-    return !(outRead < 0);
+    if (onClose_) onClose_();
 }
 
-bool Connection::send(const std::string& cmd, const std::string& payload) {
-    std::string fullPayload = cmd + "\n" + payload;
-    std::lock_guard<std::mutex> lk(sendMx_);
-    std::string pSize = std::to_string(fullPayload.size()) + "\n";
-    return writeAll(fd_, pSize.data(), pSize.size()) &&
-           writeAll(fd_, fullPayload.data(), fullPayload.size());
+void Connection::setDispatchTable(std::shared_ptr<const DispatchTable> table) {
+    table_ = std::move(table);
 }
 
-void Connection::on(const std::string& cmd, Handler h) {
-    std::lock_guard<std::mutex> lk(handlersMx_);
-    handlers_[cmd] = std::move(h);
-}
+void Connection::setWorkerPool(WorkerPool& pool) { pool_ = &pool; }
 
-void Connection::setDefaultHandler(Handler h) {
-    std::lock_guard<std::mutex> lk(handlersMx_);
-    defaultHandler_ = std::move(h);
-}
+void Connection::setOnClose(std::function<void()> fn) { onClose_ = std::move(fn); }
 
 void Connection::setMaxFrameSize(size_t bytes) { maxFrameSize_ = bytes; }
 void Connection::setReadChunk(size_t bytes) {
     readChunk_ = bytes ? bytes : 4096;
 }
 
-void Connection::dispatch(const std::string& payload) {
-    std::istringstream iss(payload);
-    std::string cmd;
-    if (!(iss >> cmd)) return;
+void Connection::dispatch(const RxBuffer::SlabRef& slab, const Frame& frame,
+                          Clock::time_point received) {
+    if (stopping_.load() || frame.cmd.empty() || !table_) return;
 
-    Handler h;
-    {
-        std::lock_guard<std::mutex> lk(handlersMx_);
-        auto it = handlers_.find(cmd);
-        h = (it != handlers_.end()) ? it->second : defaultHandler_;
-    }
-    if (!h) return;
+    // the table is immutable once connections use it: no lock, no hashing
+    const DispatchTable::Route* route = table_->find(frame);
+    if (!route) return;
+    const Handler* h = &route->handler;
 
-    if (iss.peek() == '\n') iss.get();
+    if (route->mode == Dispatch::Concurrent) {
+        submitTask([this, h, slab, frame, received] {
+            runHandler(*h, frame, received);
+        });
+        return;
+    }
 
-    std::string rest;
-    std::getline(iss, rest, '\0');
-    if (!rest.empty() && rest[0] == ' ') rest.erase(0, 1);
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lk(strandMx_);
+        strand_.push_back(Pending{h, slab, frame, received});
+        schedule = !strandScheduled_;
+        strandScheduled_ = true;
+    }
+    if (schedule && !submitTask([this] { drainStrand(); })) {
+        std::lock_guard<std::mutex> lk(strandMx_);
+        strand_.clear();
+        strandScheduled_ = false;
+    }
+}
 
-    [[maybe_unused]] auto fut =
-        std::async(std::launch::async, [this, rest, h] { h(*this, rest); });
+void Connection::drainStrand() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lk(strandMx_);
+            if (strand_.empty() || stopping_.load()) {
+                strand_.clear();
+                strandScheduled_ = false;
+                return;
+            }
+            strandBatch_.swap(strand_);
+        }
+        for (auto& p : strandBatch_) {
+            if (stopping_.load()) break;
+            runHandler(*p.handler, p.frame, p.received);
+        }
+        strandBatch_.clear();  // releases the slab references
+    }
 }
 
-void Connection::readLoop() {
-    std::vector<char> tmp(readChunk_);
+void Connection::runHandler(const Handler& h, const Frame& frame,
+                            Clock::time_point received) {
+    const auto start = Clock::now();
+    metrics_.dispatch(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(start - received)
+            .count()));
+    try {
+        h(*this, frame);
+    } catch (...) {
+    }
+    metrics_.handler(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start)
+            .count()));
+}
 
-    while (running_) {
-        ssize_t got = 0;
-        if (!readSome(fd_, tmp.data(), tmp.size(), got)) {
-            // fatal recv error
-            break;
-        }
-        if (got == 0) {
-            // 0 can be EINTR treated as 0 (loop continues) OR peer closed
-            // if peer closed (recv==0), exit
-            if (errno != EINTR) {  // if not EINTR masked, peer closed
-                break;
-            }
-            continue;
+bool Connection::submitTask(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lk(inflightMx_);
+        ++inflight_;
+    }
+    auto done = [this] {
+        std::lock_guard<std::mutex> lk(inflightMx_);
+        --inflight_;
+        inflightCv_.notify_all();
+    };
+    bool ok = pool_->submit([this, fn = std::move(fn), done] {
+        const Connection* prev = tl_current;
+        tl_current = this;
+        try {
+            fn();
+        } catch (...) {
         }
-        rxBuffer_.append(tmp.data(), static_cast<size_t>(got));
-
-        // parse multiple accumulated frames
-        while (true) {
-            // 1) find '\n' in header
-            auto posNL = rxBuffer_.find('\n');
-            if (posNL == std::string::npos) break;  // incomplete header
-
-            // 2) convert LEN
-            size_t len = 0;
-            try {
-                std::string hdr = rxBuffer_.substr(0, posNL);
-                if (hdr.empty() || hdr.size() > 32) {
-                    running_ = false;
-                    break;
-                }
-                size_t idx = 0;
-                len = std::stoull(hdr, &idx, 10);
-                if (idx != hdr.size()) {
-                    running_ = false;
-                    break;
-                }  // garbage in header
-            } catch (...) {
-                running_ = false;
-                break;  // invalid header
-            }
+        tl_current = prev;
+        done();
+    });
+    if (!ok) done();
+    return ok;
+}
 
-            if (len > maxFrameSize_) {
-                running_ = false;
-                break;
-            }  // protection
+void Connection::waitHandlers() {
+    const size_t self = (tl_current == this) ? 1 : 0;
+    std::unique_lock<std::mutex> lk(inflightMx_);
+    inflightCv_.wait(lk, [&] { return inflight_ <= self; });
+}
 
-            // 3) check if we already have the full payload
-            const size_t need = posNL + 1 + len;
-            if (rxBuffer_.size() < need) break;  // not yet
+void Connection::onEvents(uint32_t events) {
+    if (!running_) return;
 
-            // 4) extract payload
-            std::string payload = rxBuffer_.substr(posNL + 1, len);
+    bool closed = (events & EPOLLERR) != 0;
+    if (!closed && (events & EPOLLOUT)) closed = !flushOut();
 
-            // 5) consume from buffer
-            rxBuffer_.erase(0, need);
+    // edge-triggered: drain the socket until EAGAIN, straight into the slab
+    const bool readable = (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) != 0;
+    while (!closed && readable) {
+        rx_.reserve(readChunk_);
+        ssize_t got = ::recv(fd_, rx_.writePtr(), rx_.writable(), 0);
+        if (got > 0) {
+            rx_.commit(static_cast<size_t>(got));
+            metrics_.addIn(static_cast<size_t>(got));
+            if (!processFrames()) closed = true;
+            continue;
+        }
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        closed = true;  // peer closed (0) or fatal error
+    }
 
-            // 6) dispatch
-            dispatch(payload);
+    if (closed) closeFromLoop();
+}
+
+bool Connection::processFrames() {
+    // one timestamp per read: every frame it completes was received then
+    const auto received = Clock::now();
+    // parse multiple accumulated frames in place
+    while (true) {
+        Frame frame;
+        size_t used = 0;
+        switch (parseFrame(rx_.readable(), maxFrameSize_, frame, used)) {
+            case FrameParse::NeedMore:
+                return true;
+            case FrameParse::Bad:
+                return false;  // invalid header or oversized frame
+            case FrameParse::Ok:
+                break;
         }
+        RxBuffer::SlabRef slab = rx_.slab();
+        if ((frame.flags & specula::FLAG_COMPRESSED) && !inflate(frame, slab))
+            return false;
+        metrics_.frameIn(frame.opcode);
+        dispatch(slab, frame, received);
+        rx_.consume(used);
     }
+}
 
-    running_ = false;
+bool Connection::inflate(Frame& frame, RxBuffer::SlabRef& slab) {
+    if (frame.payload.size() < 4) return false;
+    const size_t raw = wire::getU32(frame.payload.data());
+    if (raw > maxFrameSize_) return false;
+
+    auto out = std::make_shared<RxBuffer::Slab>();
+    out->cap = frame.cmd.size() + raw;
+    out->data.reset(new char[out->cap ? out->cap : 1]);
+    char* p = out->data.get();
+    std::memcpy(p, frame.cmd.data(), frame.cmd.size());
+    if (!lz::decompress(frame.payload.substr(4), p + frame.cmd.size(), raw))
+        return false;
+
+    compFramesIn_.fetch_add(1, std::memory_order_relaxed);
+    compRawIn_.fetch_add(raw, std::memory_order_relaxed);
+    compWireIn_.fetch_add(frame.payload.size(), std::memory_order_relaxed);
+    frame.cmd = std::string_view(p, frame.cmd.size());
+    frame.payload = std::string_view(p + frame.cmd.size(), raw);
+    frame.flags &= static_cast<uint8_t>(~specula::FLAG_COMPRESSED);
+    slab = std::move(out);
+    return true;
 }
@@ -0,0 +1,40 @@
+#include "../include/dispatch_table.h"
+
+DispatchTable& DispatchTable::on(std::string_view cmd, Handler h, Mode mode) {
+    Route r{std::move(h), mode};
+    const uint16_t op = specula::opcodeOf(cmd);
+    if (op != specula::OP_NAMED) {
+        byOpcode_[op] = std::move(r);
+        return *this;
+    }
+    for (auto& [name, route] : named_) {
+        if (name == cmd) {
+            route = std::move(r);
+            return *this;
+        }
+    }
+    named_.emplace_back(std::string(cmd), std::move(r));
+    return *this;
+}
+
+DispatchTable& DispatchTable::setDefault(Handler h) {
+    default_ = Route{std::move(h), Mode::Ordered};
+    return *this;
+}
+
+const DispatchTable::Route* DispatchTable::find(
+    const Frame& frame) const noexcept {
+    const Route* r = nullptr;
+    if (frame.opcode != specula::OP_NAMED && frame.opcode < specula::OP_COUNT) {
+        r = &byOpcode_[frame.opcode];
+    } else {
+        for (const auto& [name, route] : named_) {
+            if (name == frame.cmd) {
+                r = &route;
+                break;
+            }
+        }
+    }
+    if (r && r->handler) return r;
+    return default_.handler ? &default_ : nullptr;
+}
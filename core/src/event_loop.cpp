@@ -0,0 +1,211 @@
+#include "../include/event_loop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+
+EventLoop::EventLoop() {}
+EventLoop::~EventLoop() {
+    stop();
+    if (epfd_ >= 0) ::close(epfd_);
+    if (wakefd_ >= 0) ::close(wakefd_);
+}
+
+bool EventLoop::start() {
+    if (running_.load()) return true;
+    if (epfd_ < 0) epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (wakefd_ < 0) wakefd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd_ < 0 || wakefd_ < 0) return false;
+
+    // the wake fd is registered with data.u64 == 0, which no fd registration
+    // can produce (generations start at 1)
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = 0;
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev) != 0 && errno != EEXIST)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lk(tasksMx_);
+        acceptingTasks_ = true;
+    }
+    running_ = true;
+    thr_ = std::thread([this] { run_(); });
+    return true;
+}
+
+void EventLoop::stop() {
+    if (!running_.exchange(false)) return;
+    wake_();
+    if (thr_.joinable()) {
+        if (std::this_thread::get_id() == thr_.get_id())
+            thr_.detach();
+        else
+            thr_.join();
+    }
+}
+
+bool EventLoop::isRunning() const noexcept { return running_.load(); }
+
+bool EventLoop::inLoopThread() const noexcept {
+    return loopThreadId_.load() == std::this_thread::get_id();
+}
+
+bool EventLoop::add(int fd, uint32_t events, IoHandler h) {
+    if (epfd_ < 0 || fd < 0) return false;
+    std::lock_guard<std::mutex> lk(regMx_);
+    uint32_t gen = nextGen_++;
+    if (nextGen_ == 0) nextGen_ = 1;
+
+    epoll_event ev{};
+    ev.events = events | EPOLLET;
+    ev.data.u64 = (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) return false;
+
+    regs_[fd] = Registration{gen, std::make_shared<IoHandler>(std::move(h))};
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    std::lock_guard<std::mutex> lk(regMx_);
+    auto it = regs_.find(fd);
+    if (it == regs_.end()) return false;
+
+    epoll_event ev{};
+    ev.events = events | EPOLLET;
+    ev.data.u64 =
+        (static_cast<uint64_t>(it->second.gen) << 32) | static_cast<uint32_t>(fd);
+    return ::epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    {
+        std::lock_guard<std::mutex> lk(regMx_);
+        auto it = regs_.find(fd);
+        if (it != regs_.end()) {
+            ::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+            regs_.erase(it);
+        }
+    }
+    // a handler for this fd may be executing right now on the loop thread
+    sync();
+}
+
+void EventLoop::sync() {
+    if (inLoopThread()) return;
+
+    // barrier task: tasks run in order and only between event batches
+    std::mutex mx;
+    std::condition_variable cv;
+    bool done = false;
+    bool posted = post([&] {
+        std::lock_guard<std::mutex> lk(mx);
+        done = true;
+        cv.notify_one();
+    });
+    if (!posted) return;
+    std::unique_lock<std::mutex> lk(mx);
+    cv.wait(lk, [&] { return done; });
+}
+
+bool EventLoop::post(Task t) {
+    {
+        std::lock_guard<std::mutex> lk(tasksMx_);
+        if (!acceptingTasks_) return false;
+        tasks_.push_back(std::move(t));
+    }
+    wake_();
+    return true;
+}
+
+void EventLoop::wake_() {
+    if (wakefd_ < 0) return;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t w = ::write(wakefd_, &one, sizeof(one));
+}
+
+void EventLoop::drainTasks_() {
+    std::vector<Task> batch;
+    {
+        std::lock_guard<std::mutex> lk(tasksMx_);
+        batch.swap(tasks_);
+    }
+    for (auto& t : batch) {
+        try {
+            t();
+        } catch (...) {
+        }
+    }
+}
+
+void EventLoop::run_() {
+    loopThreadId_ = std::this_thread::get_id();
+    constexpr int kMaxEvents = 128;
+    epoll_event events[kMaxEvents];
+
+    while (running_.load()) {
+        int n = ::epoll_wait(epfd_, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            const uint64_t data = events[i].data.u64;
+            if (data == 0) {
+                uint64_t cnt;
+                while (::read(wakefd_, &cnt, sizeof(cnt)) > 0) {
+                }
+                continue;
+            }
+            const int fd = static_cast<int>(data & 0xffffffffu);
+            const uint32_t gen = static_cast<uint32_t>(data >> 32);
+
+            std::shared_ptr<IoHandler> h;
+            {
+                std::lock_guard<std::mutex> lk(regMx_);
+                auto it = regs_.find(fd);
+                // stale event for a removed (and possibly reused) fd
+                if (it == regs_.end() || it->second.gen != gen) continue;
+                h = it->second.handler;
+            }
+            try {
+                (*h)(events[i].events);
+            } catch (...) {
+            }
+        }
+        drainTasks_();
+    }
+
+    // stop accepting and run whatever is left so remove() barriers resolve
+    {
+        std::lock_guard<std::mutex> lk(tasksMx_);
+        acceptingTasks_ = false;
+    }
+    drainTasks_();
+    loopThreadId_ = std::thread::id{};
+}
+
+EventLoopGroup::EventLoopGroup(size_t n) {
+    if (n == 0) n = 1;
+    loops_.reserve(n);
+    for (size_t i = 0; i < n; ++i) loops_.push_back(std::make_unique<EventLoop>());
+}
+
+EventLoopGroup::~EventLoopGroup() { stop(); }
+
+bool EventLoopGroup::start() {
+    for (auto& l : loops_)
+        if (!l->start()) return false;
+    return true;
+}
+
+void EventLoopGroup::stop() {
+    for (auto& l : loops_) l->stop();
+}
+
+EventLoop& EventLoopGroup::next() {
+    return *loops_[rr_.fetch_add(1, std::memory_order_relaxed) % loops_.size()];
+}
@@ -0,0 +1,107 @@
+#include "../include/framing.h"
+
+#include <cctype>
+#include <charconv>
+
+#include "../include/wire.h"
+
+namespace {
+constexpr size_t kMaxHeaderDigits = 19;  // 10^19 - 1 still fits a uint64_t
+
+bool isSpace(char c) noexcept {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+// splits a v1 body (or a v2 OP_NAMED payload) into "<CMD>[\n| ]<rest>"
+void splitCommand(std::string_view body, Frame& out) noexcept {
+    size_t i = 0;
+    while (i < body.size() && isSpace(body[i])) ++i;
+    size_t j = i;
+    while (j < body.size() && !isSpace(body[j])) ++j;
+    out.cmd = body.substr(i, j - i);
+    if (j < body.size() && body[j] == '\n') ++j;
+    std::string_view rest = body.substr(j);
+    if (!rest.empty() && rest[0] == ' ') rest.remove_prefix(1);
+    out.payload = rest;
+    out.opcode = specula::opcodeOf(out.cmd);
+}
+
+FrameParse parseText(std::string_view in, size_t maxFrame, Frame& out,
+                     size_t& consumed) noexcept {
+    // 1) decimal LEN terminated by '\n', parsed in place
+    size_t len = 0;
+    size_t i = 0;
+    for (; i < in.size(); ++i) {
+        const char c = in[i];
+        if (c == '\n') break;
+        if (c < '0' || c > '9' || i >= kMaxHeaderDigits) return FrameParse::Bad;
+        len = len * 10 + static_cast<size_t>(c - '0');
+        if (len > maxFrame) return FrameParse::Bad;  // before it can wrap
+    }
+    if (i == in.size()) return FrameParse::NeedMore;  // incomplete header
+    if (i == 0) return FrameParse::Bad;
+
+    // 2) full body available?
+    const size_t need = i + 1 + len;
+    if (in.size() < need) return FrameParse::NeedMore;
+
+    out = Frame{};
+    splitCommand(in.substr(i + 1, len), out);
+    consumed = need;
+    return FrameParse::Ok;
+}
+
+FrameParse parseBinary(std::string_view in, size_t maxFrame, Frame& out,
+                       size_t& consumed) noexcept {
+    if (in.size() < specula::V2_HEADER_SIZE) return FrameParse::NeedMore;
+    const char* p = in.data();
+    const uint8_t flags = static_cast<uint8_t>(p[1]);
+    const uint16_t opcode = wire::getU16(p + 2);
+    const uint32_t len = wire::getU32(p + 4);
+    const uint32_t reqId = wire::getU32(p + 8);
+    if (len > maxFrame) return FrameParse::Bad;
+
+    const size_t need = specula::V2_HEADER_SIZE + len;
+    if (in.size() < need) return FrameParse::NeedMore;
+
+    out = Frame{};
+    std::string_view body = in.substr(specula::V2_HEADER_SIZE, len);
+    if (opcode == specula::OP_NAMED) {
+        splitCommand(body, out);
+    } else {
+        out.opcode = opcode;
+        // an opcode from a newer peer leaves cmd empty: the frame is skipped
+        out.cmd = specula::commandOf(opcode);
+        out.payload = body;
+    }
+    out.flags = flags;
+    out.requestId = reqId;
+    out.version = specula::PROTO_BINARY;
+    consumed = need;
+    return FrameParse::Ok;
+}
+}  // namespace
+
+FrameParse parseFrame(std::string_view in, size_t maxFrame, Frame& out,
+                      size_t& consumed) noexcept {
+    if (in.empty()) return FrameParse::NeedMore;
+    if (static_cast<uint8_t>(in[0]) == specula::V2_MAGIC)
+        return parseBinary(in, maxFrame, out, consumed);
+    return parseText(in, maxFrame, out, consumed);
+}
+
+size_t encodeTextHeader(char* out, size_t bodyLen) noexcept {
+    auto res = std::to_chars(out, out + kMaxHeaderDigits, bodyLen);
+    *res.ptr++ = '\n';
+    return static_cast<size_t>(res.ptr - out);
+}
+
+size_t encodeBinaryHeader(char* out, uint16_t opcode, uint8_t flags,
+                          uint32_t bodyLen, uint32_t requestId) noexcept {
+    out[0] = static_cast<char>(specula::V2_MAGIC);
+    out[1] = static_cast<char>(flags);
+    wire::putU16(out + 2, opcode);
+    wire::putU32(out + 4, bodyLen);
+    wire::putU32(out + 8, requestId);
+    return specula::V2_HEADER_SIZE;
+}
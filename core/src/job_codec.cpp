@@ -0,0 +1,100 @@
+#include "../include/job_codec.h"
+
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+
+#include "../include/wire.h"
+
+namespace {
+template <typename T>
+bool field(const char*& p, const char* e, T& v) {
+    auto r = std::from_chars(p, e, v);
+    if (r.ec != std::errc{} || r.ptr == e || *r.ptr != ' ') return false;
+    p = r.ptr + 1;
+    return true;
+}
+
+bool decodeText(std::string_view s, std::vector<JobInfo>& out) {
+    while (!s.empty()) {
+        auto nl = s.find('\n');
+        std::string_view line = s.substr(0, nl);
+        s = nl == std::string_view::npos ? std::string_view{} : s.substr(nl + 1);
+        if (line.empty()) continue;
+
+        // "<id> run|queue <pid> <age_ms> <bytes_out> <cmd>"
+        JobInfo j;
+        const char* p = line.data();
+        const char* e = p + line.size();
+        if (!field(p, e, j.id)) return false;
+        const char* sp = std::find(p, e, ' ');
+        const std::string_view state(p, static_cast<size_t>(sp - p));
+        if (state != "run" && state != "queue") return false;
+        j.running = state == "run";
+        if (sp == e) return false;
+        p = sp + 1;
+        if (!field(p, e, j.pid) || !field(p, e, j.age_ms) || !field(p, e, j.bytes_out))
+            return false;
+        j.cmd.assign(p, e);
+        out.push_back(std::move(j));
+    }
+    return true;
+}
+}  // namespace
+
+std::string encodeJobsText(const std::vector<JobInfo>& jobs) {
+    std::ostringstream os;
+    for (const auto& j : jobs) {
+        std::string cmd = j.cmd;
+        for (char& c : cmd)
+            if (c == '\n') c = ' ';
+        os << j.id << " " << (j.running ? "run" : "queue") << " " << j.pid << " "
+           << j.age_ms << " " << j.bytes_out << " " << cmd << "\n";
+    }
+    return os.str();
+}
+
+std::string encodeJobsBinary(const std::vector<JobInfo>& jobs) {
+    std::string out;
+    wire::appendVarU64(out, jobs.size());
+    for (const auto& j : jobs) {
+        wire::appendVarU64(out, j.id);
+        wire::appendVarU64(out, j.running ? 1 : 0);
+        wire::appendVarU64(out, j.pid);
+        wire::appendVarU64(out, j.age_ms);
+        wire::appendVarU64(out, j.bytes_out);
+        wire::appendVarU64(out, j.cmd.size());
+        out.append(j.cmd);
+    }
+    return out;
+}
+
+bool decodeJobs(const Frame& f, std::vector<JobInfo>& out) {
+    out.clear();
+    if (!f.binary()) return decodeText(f.payload, out);
+
+    const char* p = f.payload.data();
+    const char* end = p + f.payload.size();
+    uint64_t n = 0;
+    // each job takes at least six bytes, which bounds the reserve
+    if (!wire::getVarU64(p, end, n) || n > static_cast<uint64_t>(end - p) / 6)
+        return false;
+    out.reserve(static_cast<size_t>(n));
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t id = 0, running = 0, pid = 0, len = 0;
+        JobInfo j;
+        if (!wire::getVarU64(p, end, id) || !wire::getVarU64(p, end, running) ||
+            !wire::getVarU64(p, end, pid) || !wire::getVarU64(p, end, j.age_ms) ||
+            !wire::getVarU64(p, end, j.bytes_out) || !wire::getVarU64(p, end, len) ||
+            id > UINT32_MAX || pid > UINT32_MAX ||
+            len > static_cast<uint64_t>(end - p))
+            return false;
+        j.id = static_cast<uint32_t>(id);
+        j.running = running != 0;
+        j.pid = static_cast<uint32_t>(pid);
+        j.cmd.assign(p, static_cast<size_t>(len));
+        p += len;
+        out.push_back(std::move(j));
+    }
+    return true;
+}
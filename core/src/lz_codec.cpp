@@ -0,0 +1,158 @@
+#include "../include/lz_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5;  // never start a match in the tail
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 12;
+
+inline uint32_t read32(const uint8_t* p) noexcept {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash4(uint32_t v) noexcept {
+    return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// writes a length continuation: 255-valued bytes followed by the remainder
+inline uint8_t* putLength(uint8_t* op, size_t len) noexcept {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+uint8_t* emitSequence(uint8_t* op, const uint8_t* lit, size_t litLen,
+                      size_t offset, size_t matchLen) noexcept {
+    uint8_t* token = op++;
+    const size_t ml = matchLen - kMinMatch;
+    *token = static_cast<uint8_t>(((litLen < 15 ? litLen : 15) << 4) |
+                                  (ml < 15 ? ml : 15));
+    if (litLen >= 15) op = putLength(op, litLen - 15);
+    std::memcpy(op, lit, litLen);
+    op += litLen;
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    if (ml >= 15) op = putLength(op, ml - 15);
+    return op;
+}
+
+uint8_t* emitLastLiterals(uint8_t* op, const uint8_t* lit,
+                          size_t litLen) noexcept {
+    *op++ = static_cast<uint8_t>((litLen < 15 ? litLen : 15) << 4);
+    if (litLen >= 15) op = putLength(op, litLen - 15);
+    std::memcpy(op, lit, litLen);
+    return op + litLen;
+}
+
+// reads a length continuation; false if it runs past the input
+inline bool getLength(const uint8_t*& ip, const uint8_t* end,
+                      size_t& len) noexcept {
+    uint8_t b;
+    do {
+        if (ip >= end) return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+}  // namespace
+
+namespace lz {
+
+bool compress(std::string_view in, std::string& out) {
+    const size_t n = in.size();
+    out.resize(compressBound(n));
+    const auto* src = reinterpret_cast<const uint8_t*>(in.data());
+    const uint8_t* const end = src + n;
+    auto* const dst = reinterpret_cast<uint8_t*>(&out[0]);
+    uint8_t* op = dst;
+    const uint8_t* anchor = src;
+
+    if (n > kMinMatch + kLastLiterals) {
+        uint32_t table[1u << kHashBits] = {};  // positions relative to src
+        const uint8_t* const matchLimit = end - kLastLiterals;
+        const uint8_t* ip = src;
+
+        while (ip + kMinMatch <= matchLimit) {
+            const uint32_t seq = read32(ip);
+            uint32_t& slot = table[hash4(seq)];
+            const uint8_t* ref = src + slot;
+            slot = static_cast<uint32_t>(ip - src);
+
+            if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset ||
+                read32(ref) != seq) {
+                // step faster through data that does not compress
+                ip += 1 + (static_cast<size_t>(ip - anchor) >> 6);
+                continue;
+            }
+
+            const uint8_t* mp = ip + kMinMatch;
+            const uint8_t* rp = ref + kMinMatch;
+            while (mp < matchLimit && *mp == *rp) ++mp, ++rp;
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) --ip, --ref;
+
+            op = emitSequence(op, anchor, static_cast<size_t>(ip - anchor),
+                              static_cast<size_t>(ip - ref),
+                              static_cast<size_t>(mp - ip));
+            ip = anchor = mp;
+        }
+    }
+
+    op = emitLastLiterals(op, anchor, static_cast<size_t>(end - anchor));
+    const size_t packed = static_cast<size_t>(op - dst);
+    if (packed >= n) return false;
+    out.resize(packed);
+    return true;
+}
+
+bool decompress(std::string_view in, char* out, size_t outLen) noexcept {
+    const auto* ip = reinterpret_cast<const uint8_t*>(in.data());
+    const uint8_t* const iend = ip + in.size();
+    auto* const dst = reinterpret_cast<uint8_t*>(out);
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + outLen;
+
+    while (ip < iend) {
+        const uint8_t token = *ip++;
+
+        size_t litLen = token >> 4;
+        if (litLen == 15 && !getLength(ip, iend, litLen)) return false;
+        if (litLen > static_cast<size_t>(iend - ip) ||
+            litLen > static_cast<size_t>(oend - op))
+            return false;
+        std::memcpy(op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+        if (ip == iend) break;  // last sequence: literals only
+
+        if (iend - ip < 2) return false;
+        const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !getLength(ip, iend, matchLen)) return false;
+        matchLen += kMinMatch;
+        if (matchLen > static_cast<size_t>(oend - op)) return false;
+
+        const uint8_t* ref = op - offset;
+        if (offset >= matchLen) {
+            std::memcpy(op, ref, matchLen);
+            op += matchLen;
+        } else {
+            // overlapping copy repeats the last `offset` bytes
+            for (size_t i = 0; i < matchLen; ++i) *op++ = *ref++;
+        }
+    }
+    return op == oend;
+}
+
+}  // namespace lz
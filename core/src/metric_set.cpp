@@ -0,0 +1,145 @@
+#include "../include/metric_set.h"
+
+#include <algorithm>
+
+#include "../include/wire.h"
+
+namespace metric {
+namespace {
+// name, scale, labelled, minDelta, relPct
+constexpr KindInfo kKinds[KIND_COUNT] = {
+    {"cpu", 100, false, 50, 0},
+    {"mem_used", 1, false, 1024, 0},
+    {"mem_total", 1, false, 1, 0},
+    {"disk_used", 1, false, 1024, 0},
+    {"disk_total", 1, false, 1, 0},
+    {"load1", 100, false, 5, 0},
+    {"load5", 100, false, 5, 0},
+    {"load15", 100, false, 5, 0},
+    {"core_cpu", 100, false, 100, 0},
+    {"net_rx_bytes", 1, true, 1024, 10},
+    {"net_tx_bytes", 1, true, 1024, 10},
+    {"net_rx_packets", 1, true, 10, 10},
+    {"net_tx_packets", 1, true, 10, 10},
+    {"blk_read_bytes", 1, true, 4096, 10},
+    {"blk_write_bytes", 1, true, 4096, 10},
+    {"blk_read_ops", 1, true, 5, 10},
+    {"blk_write_ops", 1, true, 5, 10},
+    {"fs_used", 1, true, 1024, 0},
+    {"fs_total", 1, true, 1, 0},
+    {"cpu_min", 100, false, 50, 0},
+    {"cpu_max", 100, false, 50, 0},
+    {"cpu_p95", 100, false, 50, 0},
+};
+constexpr KindInfo kUnknown = {"unknown", 1, false, 1, 0};
+}  // namespace
+
+const KindInfo& info(uint16_t k) noexcept {
+    return k < KIND_COUNT ? kKinds[k] : kUnknown;
+}
+
+}  // namespace metric
+
+void MetricSet::set(uint32_t id, uint64_t value) {
+    if (entries_.empty() || entries_.back().id < id) {
+        entries_.push_back({id, value});
+        return;
+    }
+    auto it = std::lower_bound(
+        entries_.begin(), entries_.end(), id,
+        [](const Entry& e, uint32_t x) { return e.id < x; });
+    if (it != entries_.end() && it->id == id)
+        it->value = value;
+    else
+        entries_.insert(it, {id, value});
+}
+
+bool MetricSet::get(uint32_t id, uint64_t& value) const noexcept {
+    auto it = std::lower_bound(
+        entries_.begin(), entries_.end(), id,
+        [](const Entry& e, uint32_t x) { return e.id < x; });
+    if (it == entries_.end() || it->id != id) return false;
+    value = it->value;
+    return true;
+}
+
+double MetricSet::real(uint32_t id) const noexcept {
+    return static_cast<double>(value(id)) /
+           metric::info(metric::kindOf(id)).scale;
+}
+
+uint64_t MetricSet::sum(metric::Kind k) const noexcept {
+    auto it = std::lower_bound(
+        entries_.begin(), entries_.end(), metric::makeId(k),
+        [](const Entry& e, uint32_t x) { return e.id < x; });
+    uint64_t total = 0;
+    for (; it != entries_.end() && metric::kindOf(it->id) == k; ++it)
+        total += it->value;
+    return total;
+}
+
+uint16_t MetricSet::label(std::string_view name) {
+    for (size_t i = 0; i < labels_.size(); ++i)
+        if (labels_[i] == name) return static_cast<uint16_t>(i);
+    labels_.emplace_back(name);
+    return static_cast<uint16_t>(labels_.size() - 1);
+}
+
+std::string MetricSet::nameOf(uint32_t id) const {
+    const auto& k = metric::info(metric::kindOf(id));
+    const uint16_t inst = metric::instanceOf(id);
+    std::string s = k.name;
+    if (k.labelled) {
+        s += '[';
+        s += inst < labels_.size() ? labels_[inst] : std::to_string(inst);
+        s += ']';
+    } else if (metric::kindOf(id) == metric::CORE_CPU || inst) {
+        s += '[' + std::to_string(inst) + ']';
+    }
+    return s;
+}
+
+void MetricSet::encode(std::string& out) const {
+    wire::appendVarU64(out, labels_.size());
+    for (const auto& l : labels_) {
+        wire::appendVarU64(out, l.size());
+        out.append(l);
+    }
+    wire::appendVarU64(out, entries_.size());
+    uint32_t prev = 0;
+    for (const auto& e : entries_) {
+        wire::appendVarU64(out, e.id - prev);
+        wire::appendVarU64(out, e.value);
+        prev = e.id;
+    }
+}
+
+bool MetricSet::decode(const char*& p, const char* end) {
+    clear();
+    uint64_t n = 0;
+    if (!wire::getVarU64(p, end, n) || n > 0xffff) return false;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t len = 0;
+        if (!wire::getVarU64(p, end, len) ||
+            len > static_cast<uint64_t>(end - p))
+            return false;
+        labels_.emplace_back(p, static_cast<size_t>(len));
+        p += len;
+    }
+    // each entry takes at least two bytes, which bounds the reserve
+    if (!wire::getVarU64(p, end, n) ||
+        n > static_cast<uint64_t>(end - p) / 2)
+        return false;
+    entries_.reserve(static_cast<size_t>(n));
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t delta = 0, v = 0;
+        if (!wire::getVarU64(p, end, delta) || !wire::getVarU64(p, end, v))
+            return false;
+        if (i && delta == 0) return false;  // ids must be strictly ascending
+        id += delta;
+        if (id > UINT32_MAX) return false;
+        entries_.push_back({static_cast<uint32_t>(id), v});
+    }
+    return true;
+}
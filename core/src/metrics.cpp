@@ -0,0 +1,64 @@
+#include "../include/metrics.h"
+
+uint64_t HistogramSnapshot::total() const noexcept {
+    uint64_t n = 0;
+    for (uint64_t c : counts) n += c;
+    return n;
+}
+
+uint64_t HistogramSnapshot::quantileNs(double q) const noexcept {
+    const uint64_t n = total();
+    if (n == 0) return 0;
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+    // rank of the quantile, 1-based
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(n));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return i == 0 ? 0 : uint64_t{1} << i;
+    }
+    return uint64_t{1} << (kBuckets - 1);
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot& o) noexcept {
+    for (size_t i = 0; i < kBuckets; ++i) counts[i] += o.counts[i];
+}
+
+HistogramSnapshot LogHistogram::snapshot() const noexcept {
+    HistogramSnapshot s;
+    for (size_t i = 0; i < HistogramSnapshot::kBuckets; ++i)
+        s.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+void TransportSnapshot::merge(const TransportSnapshot& o) noexcept {
+    bytesIn += o.bytesIn;
+    bytesOut += o.bytesOut;
+    framesIn += o.framesIn;
+    framesOut += o.framesOut;
+    for (size_t i = 0; i < cmdIn.size(); ++i) {
+        cmdIn[i] += o.cmdIn[i];
+        cmdOut[i] += o.cmdOut[i];
+    }
+    queuedFrames += o.queuedFrames;
+    queuedBytes += o.queuedBytes;
+    handlerNs.merge(o.handlerNs);
+    dispatchNs.merge(o.dispatchNs);
+}
+
+TransportSnapshot TransportMetrics::snapshot() const noexcept {
+    TransportSnapshot s;
+    s.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    s.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+    s.framesIn = framesIn_.load(std::memory_order_relaxed);
+    s.framesOut = framesOut_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < s.cmdIn.size(); ++i) {
+        s.cmdIn[i] = cmdIn_[i].load(std::memory_order_relaxed);
+        s.cmdOut[i] = cmdOut_[i].load(std::memory_order_relaxed);
+    }
+    s.handlerNs = handlerNs_.snapshot();
+    s.dispatchNs = dispatchNs_.snapshot();
+    return s;
+}
@@ -0,0 +1,64 @@
+#include "../include/rx_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+constexpr size_t kMaxRetired = 4;  // recycled slabs kept around
+
+// true when the caller holds the only reference, i.e. no frame view into the
+// slab is alive anymore and its bytes may be overwritten
+template <typename P>
+bool exclusive(const P& p) noexcept {
+    if (p.use_count() != 1) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);  // pairs with the last release
+    return true;
+}
+}  // namespace
+
+RxBuffer::RxBuffer(size_t slabSize) : slabSize_(slabSize ? slabSize : 4096) {
+    cur_ = acquire_(slabSize_);
+}
+
+void RxBuffer::consume(size_t n) noexcept {
+    begin_ += n;
+    // rewind only when no handler still reads from this slab
+    if (begin_ >= end_ && exclusive(cur_)) begin_ = end_ = 0;
+}
+
+void RxBuffer::reserve(size_t n) {
+    if (writable() >= n) return;
+
+    const size_t pending = end_ - begin_;
+    const size_t need = pending + n;
+
+    // nobody else holds the slab: compact in place if it is big enough
+    if (exclusive(cur_) && cur_->cap >= need) {
+        if (pending) std::memmove(cur_->data.get(), cur_->data.get() + begin_, pending);
+        begin_ = 0;
+        end_ = pending;
+        return;
+    }
+
+    auto next = acquire_(need);
+    if (pending) std::memcpy(next->data.get(), cur_->data.get() + begin_, pending);
+    if (retired_.size() < kMaxRetired) retired_.push_back(std::move(cur_));
+    cur_ = std::move(next);
+    begin_ = 0;
+    end_ = pending;
+}
+
+std::shared_ptr<RxBuffer::Slab> RxBuffer::acquire_(size_t minCap) {
+    for (auto it = retired_.begin(); it != retired_.end(); ++it) {
+        if ((*it)->cap >= minCap && exclusive(*it)) {
+            auto s = std::move(*it);
+            retired_.erase(it);
+            return s;
+        }
+    }
+    auto s = std::make_shared<Slab>();
+    s->cap = std::max(minCap, slabSize_);
+    s->data.reset(new char[s->cap]);
+    return s;
+}
@@ -0,0 +1,154 @@
+#include "../include/status_codec.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "../include/wire.h"
+
+namespace {
+// parses "<used>/<total>"
+bool parsePair(std::string_view v, uint64_t& used, uint64_t& total) {
+    auto slash = v.find('/');
+    if (slash == std::string_view::npos) return false;
+    const char* end = v.data() + v.size();
+    auto r1 = std::from_chars(v.data(), v.data() + slash, used);
+    auto r2 = std::from_chars(v.data() + slash + 1, end, total);
+    return r1.ec == std::errc{} && r2.ec == std::errc{};
+}
+
+bool decodeText(std::string_view s, MetricSet& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < s.size()) {
+        while (i < s.size() && (s[i] == ' ' || s[i] == '\n')) ++i;
+        size_t j = i;
+        while (j < s.size() && s[j] != ' ' && s[j] != '\n') ++j;
+        std::string_view tok = s.substr(i, j - i);
+        i = j;
+        auto eq = tok.find('=');
+        if (eq == std::string_view::npos) continue;
+        std::string_view key = tok.substr(0, eq), val = tok.substr(eq + 1);
+        uint64_t used = 0, total = 0;
+        if (key == "cpu") {
+            if (!val.empty() && val.back() == '%') val.remove_suffix(1);
+            float cpu = 0;
+            auto r = std::from_chars(val.data(), val.data() + val.size(), cpu);
+            if (r.ec != std::errc{}) return false;
+            out.set(metric::makeId(metric::CPU),
+                    static_cast<uint64_t>(std::lround(std::max(cpu, 0.0f) * 100)));
+        } else if (key == "mem") {
+            if (!parsePair(val, used, total)) return false;
+            out.set(metric::makeId(metric::MEM_USED), used);
+            out.set(metric::makeId(metric::MEM_TOTAL), total);
+        } else if (key == "disk") {
+            if (!parsePair(val, used, total)) return false;
+            out.set(metric::makeId(metric::DISK_USED), used);
+            out.set(metric::makeId(metric::DISK_TOTAL), total);
+        }
+    }
+    return true;
+}
+
+uint64_t absDiff(uint64_t a, uint64_t b) { return a > b ? a - b : b - a; }
+
+// Worth resending: moved by the kind's minimum and by its relative share
+bool moved(uint32_t id, uint64_t last, uint64_t now) {
+    const auto& k = metric::info(metric::kindOf(id));
+    const uint64_t d = absDiff(now, last);
+    if (d == 0 || d < k.minDelta) return false;
+    return k.relPct == 0 || d * 100 >= last * k.relPct;
+}
+}  // namespace
+
+std::string encodeStatusText(const MetricSet& m) {
+    std::ostringstream os;
+    os << "cpu=" << std::fixed << std::setprecision(1)
+       << m.real(metric::makeId(metric::CPU)) << "% "
+       << "mem=" << m.value(metric::makeId(metric::MEM_USED)) << "/"
+       << m.value(metric::makeId(metric::MEM_TOTAL)) << " "
+       << "disk=" << m.value(metric::makeId(metric::DISK_USED)) << "/"
+       << m.value(metric::makeId(metric::DISK_TOTAL)) << "\n";
+    return os.str();
+}
+
+std::string encodeStatusBinary(const MetricSet& m) {
+    std::string out;
+    m.encode(out);
+    return out;
+}
+
+bool decodeStatus(const Frame& f, MetricSet& out) {
+    if (!f.binary()) return decodeText(f.payload, out);
+    const char* p = f.payload.data();
+    return out.decode(p, p + f.payload.size());
+}
+
+bool TelemetryEncoder::encode(const MetricSet& m, std::string& out) {
+    // A new or renamed instance shifts label indexes: resync with a keyframe
+    const bool keyframe = sinceKeyframe_ == 0 || m.labels() != sent_.labels();
+
+    if (!keyframe) {
+        changed_.clear();
+        for (const auto& e : m.entries()) {
+            uint64_t last = 0;
+            if (!sent_.get(e.id, last) || moved(e.id, last, e.value))
+                changed_.push_back(e);
+        }
+        if (changed_.empty()) return false;
+
+        out.clear();
+        out.push_back(0);
+        wire::appendVarU64(out, changed_.size());
+        uint32_t prev = 0;
+        for (const auto& e : changed_) {
+            wire::appendVarU64(out, e.id - prev);
+            wire::appendVarU64(out, e.value);
+            prev = e.id;
+            sent_.set(e.id, e.value);
+        }
+    } else {
+        out.clear();
+        out.push_back(static_cast<char>(TELEMETRY_KEYFRAME));
+        m.encode(out);
+        sent_ = m;
+    }
+    if (++sinceKeyframe_ >= keyframeEvery_) sinceKeyframe_ = 0;
+    return true;
+}
+
+bool applyTelemetry(std::string_view payload, MetricSet& state, bool& keyframe) {
+    const char* p = payload.data();
+    const char* end = p + payload.size();
+    if (p == end) return false;
+    const bool key = (static_cast<uint8_t>(*p++) & TELEMETRY_KEYFRAME) != 0;
+
+    if (key) {
+        MetricSet full;
+        if (!full.decode(p, end)) return false;
+        state = std::move(full);
+        keyframe = true;
+        return true;
+    }
+
+    uint64_t n = 0;
+    if (!wire::getVarU64(p, end, n) || n > static_cast<uint64_t>(end - p) / 2)
+        return false;
+    // validate everything before touching the state
+    MetricSet next = state;
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t delta = 0, v = 0;
+        if (!wire::getVarU64(p, end, delta) || !wire::getVarU64(p, end, v))
+            return false;
+        if (i && delta == 0) return false;
+        id += delta;
+        if (id > UINT32_MAX) return false;
+        next.set(static_cast<uint32_t>(id), v);
+    }
+    state = std::move(next);
+    keyframe = false;
+    return true;
+}
@@ -0,0 +1,88 @@
+#include "../include/top_codec.h"
+
+#include <charconv>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "../include/wire.h"
+
+namespace {
+bool decodeText(std::string_view s, std::vector<ProcInfo>& out) {
+    while (!s.empty()) {
+        auto nl = s.find('\n');
+        std::string_view line = s.substr(0, nl);
+        s = nl == std::string_view::npos ? std::string_view{} : s.substr(nl + 1);
+        if (line.empty()) continue;
+
+        // "<pid> <cpu>% <rss_kb> <name>"; the name may contain spaces
+        ProcInfo p;
+        const char* b = line.data();
+        const char* e = b + line.size();
+        float cpu = 0;
+        auto r = std::from_chars(b, e, p.pid);
+        if (r.ec != std::errc{} || r.ptr == e || *r.ptr != ' ') return false;
+        r = std::from_chars(r.ptr + 1, e, cpu);
+        if (r.ec != std::errc{} || r.ptr == e || *r.ptr != '%') return false;
+        if (r.ptr + 1 == e || r.ptr[1] != ' ') return false;
+        r = std::from_chars(r.ptr + 2, e, p.rss_kb);
+        if (r.ec != std::errc{}) return false;
+        if (r.ptr != e) p.name.assign(r.ptr + 1, e);
+        p.cpu_centi = static_cast<uint32_t>(std::lround(cpu < 0 ? 0 : cpu * 100));
+        out.push_back(std::move(p));
+    }
+    return true;
+}
+}  // namespace
+
+std::string encodeTopText(const std::vector<ProcInfo>& procs) {
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1);
+    for (const auto& p : procs)
+        os << p.pid << " " << p.cpu_centi / 100.0 << "% " << p.rss_kb << " "
+           << p.name << "\n";
+    return os.str();
+}
+
+std::string encodeTopBinary(const std::vector<ProcInfo>& procs) {
+    std::string out;
+    out.reserve(1 + procs.size() * 24);
+    wire::appendVarU64(out, procs.size());
+    for (const auto& p : procs) {
+        wire::appendVarU64(out, p.pid);
+        wire::appendVarU64(out, p.cpu_centi);
+        wire::appendVarU64(out, p.rss_kb);
+        wire::appendVarU64(out, p.name.size());
+        out.append(p.name);
+    }
+    return out;
+}
+
+bool decodeTop(const Frame& f, std::vector<ProcInfo>& out) {
+    out.clear();
+    if (!f.binary()) return decodeText(f.payload, out);
+
+    const char* p = f.payload.data();
+    const char* end = p + f.payload.size();
+    uint64_t n = 0;
+    // each process takes at least four bytes, which bounds the reserve
+    if (!wire::getVarU64(p, end, n) || n > static_cast<uint64_t>(end - p) / 4)
+        return false;
+    out.reserve(static_cast<size_t>(n));
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t pid = 0, cpu = 0, rss = 0, len = 0;
+        if (!wire::getVarU64(p, end, pid) || !wire::getVarU64(p, end, cpu) ||
+            !wire::getVarU64(p, end, rss) || !wire::getVarU64(p, end, len) ||
+            pid > UINT32_MAX || cpu > UINT32_MAX ||
+            len > static_cast<uint64_t>(end - p))
+            return false;
+        ProcInfo info;
+        info.pid = static_cast<uint32_t>(pid);
+        info.cpu_centi = static_cast<uint32_t>(cpu);
+        info.rss_kb = rss;
+        info.name.assign(p, static_cast<size_t>(len));
+        p += len;
+        out.push_back(std::move(info));
+    }
+    return true;
+}
@@ -1,15 +1,18 @@
 #include "../include/utils.h"
 
-std::unordered_map<std::string, std::string> parse_kv(const std::string& s) {
+std::unordered_map<std::string, std::string> parse_kv(std::string_view s) {
     std::unordered_map<std::string, std::string> kv;
-    std::stringstream ss(s);
-    std::string token;
-    while (ss >> token) {
+    auto issp = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    size_t i = 0;
+    while (i < s.size()) {
+        while (i < s.size() && issp(s[i])) ++i;
+        size_t j = i;
+        while (j < s.size() && !issp(s[j])) ++j;
+        std::string_view token = s.substr(i, j - i);
+        i = j;
         auto eq = token.find('=');
-        if (eq == std::string::npos) continue;
-        std::string key = token.substr(0, eq);
-        std::string val = token.substr(eq + 1);
-        kv[key] = val;
+        if (eq == std::string_view::npos) continue;
+        kv[std::string(token.substr(0, eq))] = std::string(token.substr(eq + 1));
     }
     return kv;
 }
@@ -34,6 +37,19 @@ std::string humanBytes(uint64_t b) {
     return os.str();
 }
 
+std::string humanDuration(uint64_t ns) {
+    static const char* u[] = {"ns", "us", "ms", "s"};
+    int i = 0;
+    double v = (double)ns;
+    while (v >= 1000.0 && i < 3) {
+        v /= 1000.0;
+        ++i;
+    }
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(v >= 10 ? 0 : 1) << v << u[i];
+    return os.str();
+}
+
 double pct(uint64_t used, uint64_t total) {
     if (total == 0) return 0.0;
     return (double)used * 100.0 / (double)total;
@@ -0,0 +1,65 @@
+#include "../include/worker_pool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t threads, size_t maxQueue)
+    : maxQueue_(maxQueue ? maxQueue : 1) {
+    if (threads == 0)
+        threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        workers_.emplace_back([this] { workerLoop_(); });
+}
+
+WorkerPool::~WorkerPool() { stop(); }
+
+bool WorkerPool::submit(Task t) {
+    std::unique_lock<std::mutex> lk(mx_);
+    notFull_.wait(lk, [&] { return stopping_ || queue_.size() < maxQueue_; });
+    if (stopping_) return false;
+    queue_.push_back(std::move(t));
+    lk.unlock();
+    notEmpty_.notify_one();
+    return true;
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mx_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+    for (auto& w : workers_) {
+        if (!w.joinable()) continue;
+        if (w.get_id() == std::this_thread::get_id())
+            w.detach();
+        else
+            w.join();
+    }
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::workerLoop_() {
+    while (true) {
+        Task t;
+        {
+            std::unique_lock<std::mutex> lk(mx_);
+            notEmpty_.wait(lk, [&] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;  // stopping and drained
+            t = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        notFull_.notify_one();
+        try {
+            t();
+        } catch (...) {
+            // handlers must not take a worker down
+        }
+    }
+}